@@ -54,6 +54,34 @@ typedef ucs_status_t (*ucp_am_callback_t)(void *arg, void *data, size_t length,
                                           ucp_ep_h reply_ep, unsigned flags);
 
 
+/**
+ * @ingroup UCP_ENDPOINT
+ * @brief Callback to provide a receive buffer for a large active message
+ *
+ * The callback is invoked when an active message which is sent in multiple
+ * fragments or with the rendezvous protocol starts to arrive, when its first
+ * fragment or the rendezvous request is received. The data is then received
+ * directly to the returned buffer, and when all data has arrived, the @ref ucp_am_callback_t of the same id is invoked with the buffer
+ * as @a data and without the UCP_CB_PARAM_FLAG_DATA flag. The buffer remains
+ * owned by the user.
+ *
+ * @param [in]  arg      User-defined argument, the same as the one of the
+ *                       active message callback.
+ * @param [in]  length   Length of the active message data.
+ * @param [in]  reply_ep If the active message is sent with the
+ *                       UCP_AM_SEND_REPLY flag, the sending ep
+ *                       will be passed in. If not, NULL will be passed
+ *
+ * @return Pointer to a host memory buffer of at least @a length bytes, or NULL
+ *         to receive the data to a buffer allocated by UCP.
+ *
+ * @note This callback could be set and released
+ *       by @ref ucp_worker_set_am_recv_buffer_handler function.
+ */
+typedef void *(*ucp_am_recv_buffer_callback_t)(void *arg, size_t length,
+                                               ucp_ep_h reply_ep);
+
+
 /**
  * @ingroup UCP_WORKER
  * @brief Flags for a UCP AM callback
@@ -122,6 +150,27 @@ ucs_status_t ucp_worker_set_am_handler(ucp_worker_h worker, uint16_t id,
                                        uint32_t flags);
 
 
+/**
+ * @ingroup UCP_WORKER
+ * @brief Add user defined callback which provides receive buffers for large
+ *        active messages.
+ *
+ * This routine installs a callback which is called when a large active message
+ * with a specific id starts to arrive, and provides the buffer to receive its
+ * data to. Without it, large active messages are received to buffers allocated
+ * by UCP.
+ *
+ * @param [in]  worker      UCP worker on which to set the callback
+ * @param [in]  id          Active message id.
+ * @param [in]  cb          Receive buffer callback. NULL to clear.
+ *
+ * @return Error code as defined by @ref ucs_status_t
+ */
+ucs_status_t ucp_worker_set_am_recv_buffer_handler(ucp_worker_h worker,
+                                                   uint16_t id,
+                                                   ucp_am_recv_buffer_callback_t cb);
+
+
 /**
  * @ingroup UCP_COMM
  * @brief Send Active Message
@@ -167,6 +216,212 @@ ucs_status_ptr_t ucp_am_send_nb(ucp_ep_h ep, uint16_t id,
 void ucp_am_data_release(ucp_worker_h worker, void *data);
 
 
+/**
+ * @ingroup UCP_WORKER
+ * @brief Type of an operation submitted by @ref ucp_worker_submit.
+ */
+typedef enum ucp_submit_op_type {
+    UCP_SUBMIT_OP_TAG_SEND, /**< Tagged send, as @ref ucp_tag_send_nb */
+    UCP_SUBMIT_OP_TAG_RECV, /**< Tagged receive, as @ref ucp_tag_recv_nb */
+    UCP_SUBMIT_OP_PUT,      /**< Remote memory write, as @ref ucp_put_nb */
+    UCP_SUBMIT_OP_GET       /**< Remote memory read, as @ref ucp_get_nb */
+} ucp_submit_op_type_t;
+
+
+/**
+ * @ingroup UCP_WORKER
+ * @brief Completion callback of an operation submitted by
+ *        @ref ucp_worker_submit.
+ *
+ * The callback is invoked from @ref ucp_worker_progress on the thread which
+ * progresses the worker, and not on the thread which submitted the operation.
+ *
+ * @param [in]  arg      User-defined argument from the submitted operation.
+ * @param [in]  status   Completion status of the operation.
+ * @param [in]  info     Completion information of a tagged receive, or NULL
+ *                       for other operation types.
+ */
+typedef void (*ucp_submit_callback_t)(void *arg, ucs_status_t status,
+                                      const ucp_tag_recv_info_t *info);
+
+
+/**
+ * @ingroup UCP_WORKER
+ * @brief Operation descriptor for @ref ucp_worker_submit.
+ *
+ * The meaning of the fields follows the arguments of the corresponding
+ * non-blocking routine. For @ref UCP_SUBMIT_OP_PUT and @ref UCP_SUBMIT_OP_GET,
+ * @a count is the length in bytes and @a datatype is ignored.
+ */
+typedef struct ucp_submit_op {
+    ucp_submit_op_type_t  type;        /**< Operation type */
+    ucp_ep_h              ep;          /**< Destination endpoint, unused for
+                                            receive operations */
+    void                  *buffer;     /**< Local buffer */
+    size_t                count;       /**< Number of elements, or length in
+                                            bytes for RMA operations */
+    ucp_datatype_t        datatype;    /**< Datatype of tagged operations */
+    ucp_tag_t             tag;         /**< Message tag */
+    ucp_tag_t             tag_mask;    /**< Tag mask of a receive operation */
+    uint64_t              remote_addr; /**< Remote address of RMA operations */
+    ucp_rkey_h            rkey;        /**< Remote key of RMA operations */
+    ucp_submit_callback_t cb;          /**< Completion callback, may be NULL */
+    void                  *arg;        /**< Argument passed to @a cb */
+} ucp_submit_op_t;
+
+
+/**
+ * @ingroup UCP_WORKER
+ * @brief Submit a communication operation from a thread which does not
+ *        progress the worker.
+ *
+ * This routine may be called from any thread, concurrently with
+ * @ref ucp_worker_progress and with other threads calling it, without taking
+ * the worker lock. The operation is copied to a lock-free queue of the worker,
+ * and started by the next call to @ref ucp_worker_progress on the thread which
+ * owns the worker. If the worker was created with @ref UCP_FEATURE_WAKEUP, the
+ * owner thread is woken up from @ref ucp_worker_wait.
+ *
+ * The size of the queue is set by UCX_SUBMIT_QUEUE_LEN configuration variable;
+ * the queue is disabled by default.
+ *
+ * @param [in]  worker      Worker to submit the operation to.
+ * @param [in]  op          Operation to submit. The descriptor is copied and
+ *                          may be reused after the routine returns, but the
+ *                          buffer must remain valid until @a op->cb is called.
+ *
+ * @return UCS_OK               The operation was queued.
+ * @return UCS_ERR_NO_RESOURCE  The queue is full; the operation should be
+ *                              submitted again later.
+ * @return UCS_ERR_UNSUPPORTED  The queue is disabled for this worker.
+ */
+ucs_status_t ucp_worker_submit(ucp_worker_h worker, const ucp_submit_op_t *op);
+
+
+/**
+ * @ingroup UCP_COMM
+ * @brief Receive descriptor for @ref ucp_tag_recv_batch_nb.
+ *
+ * The fields follow the arguments of @ref ucp_tag_recv_nb.
+ */
+typedef struct ucp_tag_recv_batch_elem {
+    void                  *buffer;     /**< Receive buffer */
+    size_t                count;       /**< Number of elements to receive */
+    ucp_datatype_t        datatype;    /**< Datatype of the receive buffer */
+    ucp_tag_t             tag;         /**< Message tag to expect */
+    ucp_tag_t             tag_mask;    /**< Bit mask of the tag bits to match */
+} ucp_tag_recv_batch_elem_t;
+
+
+/**
+ * @ingroup UCP_COMM
+ * @brief Handle of receives posted by @ref ucp_tag_recv_batch_nb.
+ */
+typedef struct ucp_tag_recv_batch *ucp_tag_recv_batch_h;
+
+
+/**
+ * @ingroup UCP_COMM
+ * @brief Post a batch of tagged receives.
+ *
+ * This routine posts @a count tagged receives, like calling
+ * @ref ucp_tag_recv_nb for every element of @a elems in order, but takes the
+ * worker lock and allocates the requests once for the whole batch, and skips
+ * the search of the unexpected queue when it is empty. Either all receives
+ * are posted, or none.
+ *
+ * @param [in]  worker      UCP worker that is used for the receive operations.
+ * @param [in]  elems       Array of @a count receive descriptors. The array may
+ *                          be reused after the routine returns, but the
+ *                          buffers must remain valid until the receives
+ *                          complete.
+ * @param [in]  count       Number of receives to post.
+ * @param [out] batch_p     Filled with the handle of the posted receives,
+ *                          which must be released by
+ *                          @ref ucp_tag_recv_batch_free.
+ *
+ * @return Error code as defined by @ref ucs_status_t
+ */
+ucs_status_t ucp_tag_recv_batch_nb(ucp_worker_h worker,
+                                   const ucp_tag_recv_batch_elem_t *elems,
+                                   size_t count, ucp_tag_recv_batch_h *batch_p);
+
+
+/**
+ * @ingroup UCP_COMM
+ * @brief Check the completion of a batch of tagged receives.
+ *
+ * @param [in]  batch       Receives posted by @ref ucp_tag_recv_batch_nb.
+ * @param [out] info        If not NULL, array of @a count elements which is
+ *                          filled with the information about the received
+ *                          messages as the receives complete. The same array
+ *                          must be passed to every call for the batch.
+ *
+ * @return UCS_INPROGRESS   Some of the receives are not completed yet.
+ * @return UCS_OK           All receives are completed successfully.
+ * @return otherwise        All receives are completed, and this is the error
+ *                          status of the first one which failed.
+ */
+ucs_status_t ucp_tag_recv_batch_test(ucp_tag_recv_batch_h batch,
+                                     ucp_tag_recv_info_t *info);
+
+
+/**
+ * @ingroup UCP_COMM
+ * @brief Release a batch of tagged receives.
+ *
+ * Receives of the batch which are not completed yet are canceled.
+ *
+ * @param [in]  batch       Receives posted by @ref ucp_tag_recv_batch_nb.
+ */
+void ucp_tag_recv_batch_free(ucp_tag_recv_batch_h batch);
+
+
+/**
+ * @ingroup UCP_COMM
+ * @brief Non-blocking stream receive operation of a batch of UCP-supplied
+ *        buffers.
+ *
+ * This routine is the vectored form of @ref ucp_stream_recv_data_nb. It
+ * returns up to @a iovcnt of the data buffers which are already received from
+ * endpoint @a ep, in order, without copying the data. The routine is
+ * non-blocking and therefore returns immediately.
+ *
+ * @param [in]   ep        UCP endpoint that is used for the receive operation.
+ * @param [out]  iov       Array of @a iovcnt elements, which is filled with
+ *                         the pointers to the received data and their lengths.
+ * @param [in]   iovcnt    Maximal number of data buffers to return.
+ *
+ * @return Negative value indicates an error according to @ref ucs_status_t.
+ *         On success, non-negative value (less or equal @a iovcnt) indicates
+ *         actual number of data buffers filled in @a iov array. After the data
+ *         is processed, the application is responsible for releasing the data
+ *         buffers by calling the @ref ucp_stream_data_release_iov or
+ *         @ref ucp_stream_data_release routines.
+ */
+ssize_t ucp_stream_recv_data_iov_nb(ucp_ep_h ep, ucp_dt_iov_t *iov,
+                                    size_t iovcnt);
+
+
+/**
+ * @ingroup UCP_COMM
+ * @brief Release a batch of UCP data buffers returned by
+ *        @ref ucp_stream_recv_data_iov_nb.
+ *
+ * This routine releases @a iovcnt data buffers under a single acquisition of
+ * the worker lock, which is equivalent to calling
+ * @ref ucp_stream_data_release for each of them.
+ *
+ * @param [in]  ep        Endpoint the data is received from.
+ * @param [in]  iov       Data buffers to release, as returned by
+ *                        @ref ucp_stream_recv_data_iov_nb. Only the buffer
+ *                        pointers are used.
+ * @param [in]  iovcnt    Number of data buffers in @a iov.
+ */
+void ucp_stream_data_release_iov(ucp_ep_h ep, const ucp_dt_iov_t *iov,
+                                 size_t iovcnt);
+
+
 END_C_DECLS
 
 #endif
@@ -13,6 +13,7 @@
 #include <ucp/core/ucp_context.h>
 #include <ucp/proto/proto.h>
 #include <ucp/proto/proto_am.inl>
+#include <ucp/tag/rndv.h>
 #include <ucp/dt/dt.h>
 #include <ucp/dt/dt.inl>
 
@@ -59,24 +60,43 @@ UCS_PROFILE_FUNC_VOID(ucp_am_data_release,
     ucp_recv_desc_release(rdesc);
 }
 
+static ucs_status_t ucp_worker_am_cbs_reserve(ucp_worker_h worker, uint16_t id)
+{
+    ucp_worker_am_entry_t *am_cbs;
+    size_t num_entries;
+
+    if (id < worker->am_cb_array_len) {
+        return UCS_OK;
+    }
+
+    num_entries = ucs_align_up_pow2(id + 1, UCP_AM_CB_BLOCK_SIZE);
+    am_cbs      = ucs_realloc(worker->am_cbs, num_entries *
+                              sizeof(ucp_worker_am_entry_t),
+                              "UCP AM callback array");
+    if (am_cbs == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    memset(am_cbs + worker->am_cb_array_len,
+           0, (num_entries - worker->am_cb_array_len)
+           * sizeof(ucp_worker_am_entry_t));
+
+    worker->am_cbs          = am_cbs;
+    worker->am_cb_array_len = num_entries;
+    return UCS_OK;
+}
+
 UCS_PROFILE_FUNC(ucs_status_t, ucp_worker_set_am_handler,
                  (worker, id, cb, arg, flags),
                  ucp_worker_h worker, uint16_t id, 
                  ucp_am_callback_t cb, void *arg, 
                  uint32_t flags)
 {
-    size_t num_entries;
+    ucs_status_t status;
 
-    if (id >= worker->am_cb_array_len) {
-        num_entries = ucs_align_up_pow2(id + 1, UCP_AM_CB_BLOCK_SIZE);
-        worker->am_cbs = ucs_realloc(worker->am_cbs, num_entries * 
-                                     sizeof(ucp_worker_am_entry_t),
-                                     "UCP AM callback array");
-        memset(worker->am_cbs + worker->am_cb_array_len, 
-               0, (num_entries - worker->am_cb_array_len)
-               * sizeof(ucp_worker_am_entry_t));
-        
-        worker->am_cb_array_len = num_entries;
+    status = ucp_worker_am_cbs_reserve(worker, id);
+    if (status != UCS_OK) {
+        return status;
     }
 
     worker->am_cbs[id].cb      = cb;
@@ -86,6 +106,22 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_worker_set_am_handler,
     return UCS_OK;
 }
 
+UCS_PROFILE_FUNC(ucs_status_t, ucp_worker_set_am_recv_buffer_handler,
+                 (worker, id, cb),
+                 ucp_worker_h worker, uint16_t id,
+                 ucp_am_recv_buffer_callback_t cb)
+{
+    ucs_status_t status;
+
+    status = ucp_worker_am_cbs_reserve(worker, id);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    worker->am_cbs[id].buffer_cb = cb;
+    return UCS_OK;
+}
+
 static size_t 
 ucp_am_bcopy_pack_args_single(void *dest, void *arg)
 {
@@ -347,6 +383,42 @@ static ucs_status_t ucp_am_zcopy_multi_reply(uct_pending_req_t *self)
                                  ucp_proto_am_zcopy_req_complete, 0);
 }
 
+static size_t ucp_am_rndv_rts_pack(void *dest, void *arg)
+{
+    ucp_request_t *sreq              = arg;
+    ucp_rndv_rts_hdr_t *rndv_rts_hdr = dest;
+
+    rndv_rts_hdr->am.am_id  = sreq->send.am.am_id;
+    rndv_rts_hdr->am.length = 0;
+    rndv_rts_hdr->am.flags  = sreq->send.am.flags;
+
+    return ucp_rndv_rts_pack(sreq, rndv_rts_hdr);
+}
+
+static ucs_status_t ucp_am_progress_rndv_rts(uct_pending_req_t *self)
+{
+    return ucp_do_am_bcopy_single(self, UCP_AM_ID_AM_RTS, ucp_am_rndv_rts_pack);
+}
+
+static ucs_status_t ucp_am_send_start_rndv(ucp_request_t *sreq)
+{
+    ucs_status_t status;
+
+    ucp_trace_req(sreq, "start am rndv to %s buffer %p length %zu",
+                  ucp_ep_peer_name(sreq->send.ep), sreq->send.buffer,
+                  sreq->send.length);
+
+    /* the receiver fetches the data like for a tagged rendezvous, and
+     * acknowledges with the same ATS message */
+    status = ucp_rndv_send_buffer_reg(sreq);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    sreq->send.uct.func = ucp_am_progress_rndv_rts;
+    return UCS_OK;
+}
+
 static void ucp_am_send_req_init(ucp_request_t *req, ucp_ep_h ep,
                                  const void *buffer, uintptr_t datatype,
                                  size_t count, uint16_t flags, 
@@ -373,18 +445,27 @@ ucp_am_send_req(ucp_request_t *req, size_t count,
                 ucp_send_callback_t cb, const ucp_proto_t *proto)
 {
     
+    size_t rndv_thresh  = ucp_ep_config(req->send.ep)->am_u.rndv_thresh;
     size_t zcopy_thresh = ucp_proto_get_zcopy_threshold(req, msg_config,
-                                                        count, SIZE_MAX);
+                                                        count, rndv_thresh);
     size_t max_short;
     ucs_status_t status;
     
     max_short = ucp_am_get_short_max(req, msg_config);
     
     status = ucp_request_send_start(req, max_short, 
-                                    zcopy_thresh, SIZE_MAX,
+                                    zcopy_thresh, rndv_thresh,
                                     count, msg_config,
                                     proto);
-    if (status != UCS_OK) {
+    if (status == UCS_ERR_NO_PROGRESS) {
+        ucs_assert(req->send.length >= rndv_thresh);
+        status = ucp_am_send_start_rndv(req);
+        if (status != UCS_OK) {
+            return UCS_STATUS_PTR(status);
+        }
+
+        UCP_EP_STAT_TAG_OP(req->send.ep, RNDV);
+    } else if (status != UCS_OK) {
        return UCS_STATUS_PTR(status);
     }
 
@@ -569,18 +650,19 @@ ucp_am_handle_unfinished(ucp_worker_h worker,
     uint16_t am_id;
     ucs_status_t status;
 
-    memcpy(UCS_PTR_BYTE_OFFSET(unfinished->all_data + 1, long_hdr->offset),
+    memcpy(UCS_PTR_BYTE_OFFSET(unfinished->buffer, long_hdr->offset),
            long_hdr + 1, am_length - sizeof(*long_hdr));
     unfinished->left -= am_length - sizeof(*long_hdr);
     if (unfinished->left == 0) {
         am_id = long_hdr->am_id;
         status = worker->am_cbs[am_id].cb(worker->am_cbs[am_id].context,
-                                          unfinished->all_data + 1,
+                                          unfinished->buffer,
                                           long_hdr->total_size,
                                           reply_ep,
-                                          UCP_CB_PARAM_FLAG_DATA);
+                                          (unfinished->all_data != NULL) ?
+                                          UCP_CB_PARAM_FLAG_DATA : 0);
 
-        if (status != UCS_INPROGRESS) {
+        if ((unfinished->all_data != NULL) && (status != UCS_INPROGRESS)) {
             ucs_free(unfinished->all_data);
         }
 
@@ -600,7 +682,8 @@ ucp_am_long_handler_common(void *am_arg, void *am_data, size_t am_length,
     ucp_ep_h ep                 = ucp_worker_get_ep_by_ptr(worker, 
                                                            long_hdr->ep);
     ucp_ep_ext_proto_t *ep_ext  = ucp_ep_ext_proto(ep);
-    ucp_recv_desc_t *all_data;
+    ucp_recv_desc_t *all_data   = NULL;
+    void *buffer                = NULL;
     size_t left;
     ucp_am_unfinished_t *unfinished;
 
@@ -624,25 +707,41 @@ ucp_am_long_handler_common(void *am_arg, void *am_data, size_t am_length,
                                         reply_ep);
     }
     
-    /* If I am first, I make the buffer for everyone to go into,
-     * copy myself in, and put myself on the list so people can find me
+    /* If I am first, I get the buffer for everyone to go into, from the user
+     * or by allocating it, copy myself in, and put myself on the list so
+     * people can find me
      */
-    all_data = ucs_malloc(long_hdr->total_size
-                          + sizeof(ucp_recv_desc_t),
-                          "ucp recv desc for long AM");
+    if (worker->am_cbs[long_hdr->am_id].buffer_cb != NULL) {
+        buffer = worker->am_cbs[long_hdr->am_id].buffer_cb(
+                         worker->am_cbs[long_hdr->am_id].context,
+                         long_hdr->total_size, reply_ep);
+    }
 
-    all_data->flags = UCP_RECV_DESC_FLAG_MALLOC;
+    if (buffer == NULL) {
+        all_data = ucs_malloc(long_hdr->total_size
+                              + sizeof(ucp_recv_desc_t),
+                              "ucp recv desc for long AM");
+        if (all_data == NULL) {
+            ucs_error("failed to allocate %zu bytes for active message with "
+                      "id %u", long_hdr->total_size, long_hdr->am_id);
+            return UCS_OK;
+        }
+
+        all_data->flags = UCP_RECV_DESC_FLAG_MALLOC;
+        buffer          = all_data + 1;
+    }
 
     left = long_hdr->total_size - (am_length -
                                    sizeof(ucp_am_long_hdr_t));
     
-    memcpy(UCS_PTR_BYTE_OFFSET(all_data + 1, long_hdr->offset),
+    memcpy(UCS_PTR_BYTE_OFFSET(buffer, long_hdr->offset),
            long_hdr + 1, am_length - sizeof(ucp_am_long_hdr_t));
     
     /* Can't use a desc for this because of the buffer */
     unfinished              = ucs_malloc(sizeof(ucp_am_unfinished_t),
                                          "unfinished UCP AM");
     unfinished->all_data    = all_data;
+    unfinished->buffer      = buffer;
     unfinished->left        = left;
     unfinished->msg_id      = long_hdr->msg_id;
 
@@ -672,6 +771,95 @@ ucp_am_long_handler(void *am_arg, void *am_data, size_t am_length,
                                       NULL); 
 }
 
+static void ucp_am_rndv_recv_completion(void *request, ucs_status_t status,
+                                        ucp_tag_recv_info_t *info)
+{
+    ucp_request_t *rreq = (ucp_request_t*)request - 1;
+    ucp_worker_h worker = rreq->recv.worker;
+    uint16_t am_id      = rreq->recv.am.id;
+
+    if (status == UCS_OK) {
+        status = worker->am_cbs[am_id].cb(worker->am_cbs[am_id].context,
+                                          rreq->recv.buffer, info->length,
+                                          rreq->recv.am.reply_ep,
+                                          rreq->recv.am.cb_flags);
+    } else if (status != UCS_ERR_MESSAGE_TRUNCATED) {
+        /* truncation means the message was dropped on arrival */
+        ucs_error("failed to receive rendezvous active message with id %u: %s",
+                  am_id, ucs_status_string(status));
+    }
+
+    if ((rreq->recv.am.cb_flags & UCP_CB_PARAM_FLAG_DATA) &&
+        (status != UCS_INPROGRESS)) {
+        ucs_free((ucp_recv_desc_t*)rreq->recv.buffer - 1);
+    }
+}
+
+static ucs_status_t
+ucp_am_rndv_rts_handler(void *am_arg, void *am_data, size_t am_length,
+                        unsigned am_flags)
+{
+    ucp_worker_h worker              = am_arg;
+    ucp_rndv_rts_hdr_t *rndv_rts_hdr = am_data;
+    uint16_t am_id                   = rndv_rts_hdr->am.am_id;
+    size_t length                    = rndv_rts_hdr->size;
+    ucp_recv_desc_t *desc;
+    ucp_request_t *rreq;
+    void *buffer;
+
+    rreq = ucp_request_get(worker);
+    if (rreq == NULL) {
+        ucs_error("failed to allocate rendezvous active message request");
+        return UCS_OK;
+    }
+
+    rreq->flags            = UCP_REQUEST_FLAG_RECV | UCP_REQUEST_FLAG_CALLBACK |
+                             UCP_REQUEST_FLAG_RELEASED;
+    rreq->recv.worker      = worker;
+    rreq->recv.datatype    = ucp_dt_make_contig(1);
+    rreq->recv.mem_type    = UCT_MD_MEM_TYPE_HOST;
+    rreq->recv.tag.cb      = ucp_am_rndv_recv_completion;
+    rreq->recv.am.id       = am_id;
+    rreq->recv.am.cb_flags = 0;
+    rreq->recv.am.reply_ep = (rndv_rts_hdr->am.flags & UCP_AM_SEND_REPLY) ?
+                             ucp_worker_get_ep_by_ptr(worker,
+                                                      rndv_rts_hdr->sreq.ep_ptr) :
+                             NULL;
+
+    if (ucs_unlikely((am_id >= worker->am_cb_array_len) ||
+                     (worker->am_cbs[am_id].cb == NULL))) {
+        ucs_warn("UCP Active Message was received with id : %u, but there"
+                 "is no registered callback for that id", am_id);
+        /* a zero-length receive completes the sender as truncated */
+        buffer = NULL;
+        length = 0;
+    } else if ((worker->am_cbs[am_id].buffer_cb == NULL) ||
+               ((buffer = worker->am_cbs[am_id].buffer_cb(
+                                         worker->am_cbs[am_id].context, length,
+                                         rreq->recv.am.reply_ep)) == NULL)) {
+        desc = ucs_malloc(length + sizeof(ucp_recv_desc_t),
+                          "ucp recv desc for rndv AM");
+        if (desc == NULL) {
+            ucs_error("failed to allocate %zu bytes for rendezvous active "
+                      "message with id %u", length, am_id);
+            buffer = NULL;
+            length = 0;
+        } else {
+            desc->flags            = UCP_RECV_DESC_FLAG_MALLOC;
+            buffer                 = desc + 1;
+            rreq->recv.am.cb_flags = UCP_CB_PARAM_FLAG_DATA;
+        }
+    }
+
+    rreq->recv.buffer = buffer;
+    rreq->recv.length = length;
+    ucp_dt_recv_state_init(&rreq->recv.state, buffer, rreq->recv.datatype,
+                           length);
+
+    ucp_rndv_matched(worker, rreq, rndv_rts_hdr);
+    return UCS_OK;
+}
+
 UCP_DEFINE_AM(UCP_FEATURE_EXPERIMENTAL, UCP_AM_ID_SINGLE,
               ucp_am_handler, NULL, 0);
 UCP_DEFINE_AM(UCP_FEATURE_EXPERIMENTAL, UCP_AM_ID_MULTI,
@@ -680,6 +868,8 @@ UCP_DEFINE_AM(UCP_FEATURE_EXPERIMENTAL, UCP_AM_ID_SINGLE_REPLY,
               ucp_am_handler_reply, NULL, 0);
 UCP_DEFINE_AM(UCP_FEATURE_EXPERIMENTAL, UCP_AM_ID_MULTI_REPLY,
               ucp_am_long_handler_reply, NULL, 0);
+UCP_DEFINE_AM(UCP_FEATURE_EXPERIMENTAL, UCP_AM_ID_AM_RTS,
+              ucp_am_rndv_rts_handler, NULL, 0);
 
 const ucp_proto_t ucp_am_proto = {
     .contig_short           = ucp_am_contig_short,
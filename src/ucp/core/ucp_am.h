@@ -4,6 +4,9 @@
  * See file LICENSE for terms.
  */
 
+#ifndef UCP_AM_H_
+#define UCP_AM_H_
+
 #include "ucp_ep.h"
 
 #define UCP_AM_CB_BLOCK_SIZE 16
@@ -38,7 +41,9 @@ typedef struct {
 
 typedef struct {
     ucs_list_link_t   list;       /* entry into list of unfinished AM's */
-    ucp_recv_desc_t  *all_data;   /* buffer for all parts of the AM */
+    ucp_recv_desc_t  *all_data;   /* buffer for all parts of the AM, or NULL
+                                     if the user provided the buffer */
+    void             *buffer;     /* where the parts of the AM are copied to */
     uint64_t          msg_id;     /* way to match up all parts of AM */
     size_t            left;
 } ucp_am_unfinished_t;
@@ -46,3 +51,5 @@ typedef struct {
 void ucp_am_ep_init(ucp_ep_h ep);
 
 void ucp_am_ep_cleanup(ucp_ep_h ep);
+
+#endif
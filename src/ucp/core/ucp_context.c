@@ -8,6 +8,7 @@
 #include "ucp_context.h"
 #include "ucp_request.h"
 #include <ucp/proto/proto.h>
+#include <ucp/tag/tag_match.h>
 
 #include <ucs/config/parser.h>
 #include <ucs/algorithm/crc.h>
@@ -129,6 +130,14 @@ static ucs_config_field_t ucp_config_table[] = {
    "the eager_zcopy protocol",
    ucs_offsetof(ucp_config_t, ctx.rndv_perf_diff), UCS_CONFIG_TYPE_DOUBLE},
 
+  {"RNDV_THRESH_ADAPT", "n",
+   "Adjust the rendezvous threshold of every endpoint configuration at runtime.\n"
+   "The completion times of eager and rendezvous sends of messages around the\n"
+   "threshold are measured, and the threshold is moved toward the message size\n"
+   "at which both protocols perform the same. Relevant only if UCX_RNDV_THRESH\n"
+   "is set to \"auto\", and tag matching offload is not used.",
+   ucs_offsetof(ucp_config_t, ctx.rndv_thresh_adapt), UCS_CONFIG_TYPE_BOOL},
+
   {"MAX_EAGER_LANES", NULL, "",
    ucs_offsetof(ucp_config_t, ctx.max_eager_lanes), UCS_CONFIG_TYPE_UINT},
 
@@ -213,6 +222,18 @@ static ucs_config_field_t ucp_config_table[] = {
    "cases (non-contig buffer, or sender wildcard).",
    ucs_offsetof(ucp_config_t, ctx.tm_force_thresh), UCS_CONFIG_TYPE_MEMUNITS},
 
+  {"TM_CHANNEL_BITS", "0",
+   "Number of tag bits, such as a communicator id, which select one of independent\n"
+   "tag matching partitions. Every partition has its own queues and lock, so threads\n"
+   "which receive on different partitions match in parallel, without the worker lock.\n"
+   "Receive operations must match all of these bits exactly, and tag matching offload\n"
+   "is not used. 0 disables the partitioning.",
+   ucs_offsetof(ucp_config_t, ctx.tm_channel_bits), UCS_CONFIG_TYPE_UINT},
+
+  {"TM_CHANNEL_SHIFT", "0",
+   "Offset of the lowest tag bit which selects a tag matching partition.",
+   ucs_offsetof(ucp_config_t, ctx.tm_channel_shift), UCS_CONFIG_TYPE_UINT},
+
   {"NUM_EPS", "auto",
    "An optimization hint of how many endpoints would be created on this context.\n"
    "Does not affect semantics, but only transport selection criteria and the\n"
@@ -225,6 +246,17 @@ static ucs_config_field_t ucp_config_table[] = {
    "RNDV fragment size \n",
    ucs_offsetof(ucp_config_t, ctx.rndv_frag_size), UCS_CONFIG_TYPE_MEMUNITS},
 
+  {"RNDV_CHUNK_SIZE", "inf",
+   "Size of the chunks of a zero-copy rendezvous of host memory. A larger message\n"
+   "is transferred by a pipeline of get or put operations, each one registering\n"
+   "only its own chunk of the local buffer right before it is issued.\n"
+   "\"inf\" transfers the whole message at once.",
+   ucs_offsetof(ucp_config_t, ctx.rndv_chunk_size), UCS_CONFIG_TYPE_MEMUNITS},
+
+  {"RNDV_CHUNK_WINDOW", "4",
+   "Maximal number of rendezvous chunks of a message in flight.",
+   ucs_offsetof(ucp_config_t, ctx.rndv_chunk_window), UCS_CONFIG_TYPE_UINT},
+
   {"MEMTYPE_CACHE", "y",
    "Enable memory type(cuda) cache \n",
    ucs_offsetof(ucp_config_t, ctx.enable_memtype_cache), UCS_CONFIG_TYPE_BOOL},
@@ -241,6 +273,12 @@ static ucs_config_field_t ucp_config_table[] = {
    "of all entities which connect to each other are the same.",
    ucs_offsetof(ucp_config_t, ctx.unified_mode), UCS_CONFIG_TYPE_BOOL},
 
+  {"SUBMIT_QUEUE_LEN", "0",
+   "Length of the per-worker queue of operations submitted by threads which\n"
+   "do not progress the worker, by ucp_worker_submit(). The operations are\n"
+   "started by ucp_worker_progress(). 0 disables the queue.",
+   ucs_offsetof(ucp_config_t, ctx.submit_queue_len), UCS_CONFIG_TYPE_UINT},
+
   {NULL}
 };
 UCS_CONFIG_REGISTER_TABLE(ucp_config_table, "UCP context", NULL, ucp_config_t)
@@ -1159,6 +1197,23 @@ static ucs_status_t ucp_fill_config(ucp_context_h context,
         }
     }
 
+    if ((context->config.ext.tm_channel_bits > UCP_TAG_MATCH_CHANNEL_BITS_MAX) ||
+        ((context->config.ext.tm_channel_bits +
+          context->config.ext.tm_channel_shift) > (sizeof(ucp_tag_t) * 8))) {
+        ucs_error("invalid tag matching channel: %u bits at offset %u (maximal "
+                  "number of bits: %d)", context->config.ext.tm_channel_bits,
+                  context->config.ext.tm_channel_shift,
+                  UCP_TAG_MATCH_CHANNEL_BITS_MAX);
+        status = UCS_ERR_INVALID_PARAM;
+        goto err_free;
+    }
+
+    if (context->config.ext.rndv_chunk_window == 0) {
+        ucs_error("invalid rendezvous chunk window: must be at least 1");
+        status = UCS_ERR_INVALID_PARAM;
+        goto err_free;
+    }
+
     return UCS_OK;
 
 err_free:
@@ -45,6 +45,8 @@ typedef struct ucp_context_config {
     /** The percentage allowed for performance difference between rendezvous
      *  and the eager_zcopy protocol */
     double                                 rndv_perf_diff;
+    /** Adjust the rendezvous threshold by runtime measurements */
+    int                                    rndv_thresh_adapt;
     /** Threshold for switching UCP to zero copy protocol */
     size_t                                 zcopy_thresh;
     /** Communication scheme in RNDV protocol */
@@ -55,6 +57,10 @@ typedef struct ucp_context_config {
     size_t                                 seg_size;
     /** RNDV pipeline fragment size */
     size_t                                 rndv_frag_size;
+    /** Size of a pipelined zero-copy rendezvous chunk */
+    size_t                                 rndv_chunk_size;
+    /** Maximal number of pipelined rendezvous chunks in flight */
+    unsigned                               rndv_chunk_window;
     /** Threshold for using tag matching offload capabilities. Smaller buffers
      *  will not be posted to the transport. */
     size_t                                 tm_thresh;
@@ -63,6 +69,10 @@ typedef struct ucp_context_config {
     /** Upper bound for posting tm offload receives with internal UCP
      *  preregistered bounce buffers. */
     size_t                                 tm_max_bb_size;
+    /** Number of tag bits which select a tag matching partition */
+    unsigned                               tm_channel_bits;
+    /** Offset of the tag bits which select a tag matching partition */
+    unsigned                               tm_channel_shift;
     /** Maximal size of worker name for debugging */
     unsigned                               max_worker_name;
     /** Atomic mode */
@@ -83,6 +93,8 @@ typedef struct ucp_context_config {
     int                                    flush_worker_eps;
     /** Enable optimizations suitable for homogeneous systems */
     int                                    unified_mode;
+    /** Length of the queue of operations submitted by other threads */
+    unsigned                               submit_queue_len;
 } ucp_context_config_t;
 
 
@@ -22,9 +22,26 @@
 #include <ucs/debug/log.h>
 #include <ucs/sys/string.h>
 #include <ucs/sys/sock.h>
+#include <ucs/time/time.h>
 #include <string.h>
 
 
+/* Sends of sizes within this factor of the rendezvous threshold are measured,
+ * and every update moves the threshold at most by this factor */
+#define UCP_EP_RNDV_ADAPT_RANGE       2
+/* Maximal factor between the initial and the adapted rendezvous threshold */
+#define UCP_EP_RNDV_ADAPT_MAX_SCALE   16
+/* Number of measured sends between updates of the rendezvous threshold */
+#define UCP_EP_RNDV_ADAPT_INTERVAL    32
+/* One of this many sends near the threshold uses the other protocol, so both
+ * protocols are measured on both sides of the threshold */
+#define UCP_EP_RNDV_ADAPT_EXPLORE     8
+/* Weight of the previous measurements of a protocol after a new one */
+#define UCP_EP_RNDV_ADAPT_DECAY       0.95
+/* Minimal sum of weights of the measurements of a protocol to use them */
+#define UCP_EP_RNDV_ADAPT_MIN_WEIGHT  8.0
+
+
 typedef struct {
     double reg_growth;
     double reg_overhead;
@@ -1099,6 +1116,31 @@ static void ucp_ep_config_init_attrs(ucp_worker_t *worker, ucp_rsc_index_t rsc_i
     }
 }
 
+static void ucp_ep_config_rndv_adapt_init(ucp_worker_h worker,
+                                          ucp_ep_config_t *config)
+{
+    ucp_context_h context      = worker->context;
+    ucp_ep_rndv_adapt_t *adapt = &config->tag.rndv.adapt;
+    size_t thresh              = ucs_min(config->tag.rndv.rma_thresh,
+                                         config->tag.rndv.am_thresh);
+
+    memset(adapt, 0, sizeof(*adapt));
+
+    /* Tag offload has its own limits of eager and rendezvous message sizes */
+    if (!context->config.ext.rndv_thresh_adapt ||
+        (context->config.ext.rndv_thresh != UCS_MEMUNITS_AUTO) ||
+        ucp_ep_is_tag_offload_enabled(config) ||
+        (thresh > (SIZE_MAX / (UCP_EP_RNDV_ADAPT_MAX_SCALE *
+                               UCP_EP_RNDV_ADAPT_RANGE)))) {
+        return;
+    }
+
+    adapt->enabled    = 1;
+    adapt->min_thresh = ucs_max(thresh / UCP_EP_RNDV_ADAPT_MAX_SCALE,
+                                ucs_max(config->tag.rndv.min_get_zcopy, 1));
+    adapt->max_thresh = thresh * UCP_EP_RNDV_ADAPT_MAX_SCALE;
+}
+
 void ucp_ep_config_init(ucp_worker_h worker, ucp_ep_config_t *config)
 {
     ucp_context_h context         = worker->context;
@@ -1144,8 +1186,10 @@ void ucp_ep_config_init(ucp_worker_h worker, ucp_ep_config_t *config)
     config->tag.rndv.rkey_size          = ucp_rkey_packed_size(context,
                                                                config->key.rma_bw_md_map);
     config->stream.proto                = &ucp_stream_am_proto;
+    config->stream.rndv_thresh          = SIZE_MAX;
     config->am_u.proto                  = &ucp_am_proto;
     config->am_u.reply_proto            = &ucp_am_reply_proto;
+    config->am_u.rndv_thresh            = SIZE_MAX;
     config->tag.offload.max_eager_short = -1;
     config->tag.max_eager_short         = -1;
     max_rndv_thresh                     = SIZE_MAX;
@@ -1273,6 +1317,15 @@ void ucp_ep_config_init(ucp_worker_h worker, ucp_ep_config_t *config)
                 config->tag.lane            = lane;
                 config->tag.max_eager_short = config->tag.eager.max_short;
             }
+
+            /* Active messages and stream use the AM based rendezvous of tag
+             * matching, and also the RMA based one if tag offload does not
+             * override it */
+            config->am_u.rndv_thresh = ucp_ep_is_tag_offload_enabled(config) ?
+                                       config->tag.rndv.am_thresh :
+                                       ucs_min(config->tag.rndv.rma_thresh,
+                                               config->tag.rndv.am_thresh);
+            config->stream.rndv_thresh = config->am_u.rndv_thresh;
         } else {
             /* Stub endpoint */
             config->am.max_bcopy = UCP_MIN_BCOPY;
@@ -1344,6 +1397,145 @@ void ucp_ep_config_init(ucp_worker_h worker, ucp_ep_config_t *config)
             rma_config->max_put_bcopy = UCP_MIN_BCOPY; /* Stub endpoint */
         }
     }
+
+    ucp_ep_config_rndv_adapt_init(worker, config);
+}
+
+void ucp_ep_config_rndv_adapt_start(ucp_request_t *req, size_t *rma_thresh_p,
+                                    size_t *am_thresh_p)
+{
+    ucp_ep_rndv_adapt_t *adapt = &ucp_ep_config(req->send.ep)->tag.rndv.adapt;
+    size_t length              = req->send.length;
+    size_t thresh              = ucs_min(*rma_thresh_p, *am_thresh_p);
+
+    if (!UCP_DT_IS_CONTIG(req->send.datatype) ||
+        !UCP_MEM_IS_HOST(req->send.mem_type) ||
+        (req->flags & UCP_REQUEST_FLAG_SYNC) ||
+        (length < thresh / UCP_EP_RNDV_ADAPT_RANGE) ||
+        (length > thresh * UCP_EP_RNDV_ADAPT_RANGE)) {
+        return;
+    }
+
+    if ((++adapt->explore % UCP_EP_RNDV_ADAPT_EXPLORE) == 0) {
+        if (length < thresh) {
+            if (length >= adapt->min_thresh) {
+                *rma_thresh_p = *am_thresh_p = thresh = length;
+            }
+        } else {
+            *rma_thresh_p = *am_thresh_p = thresh = SIZE_MAX;
+        }
+    }
+
+    req->flags          |= (length >= thresh) ? UCP_REQUEST_FLAG_RNDV_ADAPT_RNDV :
+                                                UCP_REQUEST_FLAG_RNDV_ADAPT_EAGER;
+    req->send.start_time = ucs_get_time();
+}
+
+/* Fit the measurements of a protocol to time = a + b * size */
+static int ucp_ep_rndv_adapt_fit(const ucp_ep_rndv_adapt_t *adapt, int is_rndv,
+                                 double *a_p, double *b_p)
+{
+    double n   = adapt->fit[is_rndv].n;
+    double x   = adapt->fit[is_rndv].x;
+    double xx  = adapt->fit[is_rndv].xx;
+    double det = (n * xx) - (x * x);
+
+    if ((n < UCP_EP_RNDV_ADAPT_MIN_WEIGHT) || (det <= (1e-6 * n * xx))) {
+        /* Not enough measurements of different sizes */
+        return 0;
+    }
+
+    *b_p = ((n * adapt->fit[is_rndv].xy) - (x * adapt->fit[is_rndv].y)) / det;
+    *a_p = (adapt->fit[is_rndv].y - (*b_p * x)) / n;
+    return 1;
+}
+
+static size_t ucp_ep_rndv_adapt_scale(size_t thresh, double factor)
+{
+    return (thresh == SIZE_MAX) ? SIZE_MAX : (size_t)(thresh * factor);
+}
+
+static void ucp_ep_config_rndv_adapt_update(ucp_worker_h worker,
+                                            ucp_ep_config_t *config)
+{
+    ucp_ep_rndv_adapt_t *adapt = &config->tag.rndv.adapt;
+    size_t old_thresh          = ucs_min(config->tag.rndv.rma_thresh,
+                                         config->tag.rndv.am_thresh);
+    double eager_a, eager_b, rndv_a, rndv_b, cross;
+    size_t thresh;
+
+    if (!ucp_ep_rndv_adapt_fit(adapt, 0, &eager_a, &eager_b) ||
+        !ucp_ep_rndv_adapt_fit(adapt, 1, &rndv_a, &rndv_b)) {
+        return;
+    }
+
+    if (eager_b > rndv_b) {
+        /* Rendezvous is faster for sizes above the crossing point */
+        cross = (rndv_a - eager_a) / (eager_b - rndv_b);
+    } else if (eager_a <= rndv_a) {
+        /* Eager is faster for all sizes */
+        cross = (double)old_thresh * UCP_EP_RNDV_ADAPT_RANGE;
+    } else {
+        return;
+    }
+
+    cross  = ucs_max(cross, (double)old_thresh / UCP_EP_RNDV_ADAPT_RANGE);
+    cross  = ucs_min(cross, (double)old_thresh * UCP_EP_RNDV_ADAPT_RANGE);
+    thresh = ucs_max(adapt->min_thresh, ucs_min(adapt->max_thresh, (size_t)cross));
+    if (thresh == old_thresh) {
+        return;
+    }
+
+    ucs_debug("worker %p ep_cfg %p: rendezvous threshold %zu -> %zu (eager: "
+              "%.3f+%.6f*size usec, rndv: %.3f+%.6f*size usec)", worker, config,
+              old_thresh, thresh, eager_a, eager_b, rndv_a, rndv_b);
+
+    /* Keep the ratio between the rma and am thresholds */
+    config->tag.rndv.rma_thresh = ucp_ep_rndv_adapt_scale(config->tag.rndv.rma_thresh,
+                                                          (double)thresh / old_thresh);
+    config->tag.rndv.am_thresh  = ucp_ep_rndv_adapt_scale(config->tag.rndv.am_thresh,
+                                                          (double)thresh / old_thresh);
+
+    UCS_STATS_UPDATE_COUNTER(worker->stats, (thresh > old_thresh) ?
+                             UCP_WORKER_STAT_TAG_TX_RNDV_THRESH_INC :
+                             UCP_WORKER_STAT_TAG_TX_RNDV_THRESH_DEC, 1);
+}
+
+void ucp_ep_config_rndv_adapt_complete(ucp_request_t *req, ucs_status_t status)
+{
+    int is_rndv = !!(req->flags & UCP_REQUEST_FLAG_RNDV_ADAPT_RNDV);
+    ucp_ep_config_t *config;
+    ucp_ep_rndv_adapt_t *adapt;
+    double size, time;
+
+    req->flags &= ~(UCP_REQUEST_FLAG_RNDV_ADAPT_EAGER |
+                    UCP_REQUEST_FLAG_RNDV_ADAPT_RNDV);
+    if (status != UCS_OK) {
+        return;
+    }
+
+    config = ucp_ep_config(req->send.ep);
+    adapt  = &config->tag.rndv.adapt;
+    if (!adapt->enabled) {
+        /* The endpoint moved to another configuration */
+        return;
+    }
+
+    size = req->send.length;
+    time = ucs_time_to_usec(ucs_get_time() - req->send.start_time);
+
+    adapt->fit[is_rndv].n  = (adapt->fit[is_rndv].n  * UCP_EP_RNDV_ADAPT_DECAY) + 1;
+    adapt->fit[is_rndv].x  = (adapt->fit[is_rndv].x  * UCP_EP_RNDV_ADAPT_DECAY) + size;
+    adapt->fit[is_rndv].y  = (adapt->fit[is_rndv].y  * UCP_EP_RNDV_ADAPT_DECAY) + time;
+    adapt->fit[is_rndv].xx = (adapt->fit[is_rndv].xx * UCP_EP_RNDV_ADAPT_DECAY) +
+                             (size * size);
+    adapt->fit[is_rndv].xy = (adapt->fit[is_rndv].xy * UCP_EP_RNDV_ADAPT_DECAY) +
+                             (size * time);
+
+    if (++adapt->count >= UCP_EP_RNDV_ADAPT_INTERVAL) {
+        adapt->count = 0;
+        ucp_ep_config_rndv_adapt_update(req->send.ep->worker, config);
+    }
 }
 
 static void ucp_ep_config_print_tag_proto(FILE *stream, const char *name,
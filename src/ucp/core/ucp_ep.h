@@ -88,6 +88,27 @@ enum {
     UCS_STATS_UPDATE_COUNTER((_ep)->stats, UCP_EP_STAT_TAG_TX_##_op, 1);
 
 
+/*
+ * Runtime adaptation of the rendezvous threshold of an endpoint configuration.
+ * The completion times of eager and rendezvous sends around the threshold are
+ * fitted, by least squares with exponentially decaying weights, to a linear
+ * function of the message size, and the threshold moves toward the size at
+ * which both functions are equal.
+ */
+typedef struct ucp_ep_rndv_adapt {
+    int                    enabled;
+    size_t                 min_thresh;   /* Lowest threshold to adapt to */
+    size_t                 max_thresh;   /* Highest threshold to adapt to */
+    unsigned               count;        /* Measured sends since last update */
+    unsigned               explore;      /* Counter of sends near the threshold */
+    struct {
+        double             n;            /* Sum of weights */
+        double             x, y;         /* Weighted sums of size and time */
+        double             xx, xy;       /* Weighted sums of size*size and size*time */
+    } fit[2];                            /* Eager and rendezvous */
+} ucp_ep_rndv_adapt_t;
+
+
 /*
  * Endpoint configuration key.
  * This is filled by to the transport selection logic, according to the local
@@ -227,6 +248,8 @@ typedef struct ucp_ep_config {
             size_t          rkey_size;
             /* BW based scale factor */
             double          scale[UCP_MAX_LANES];
+            /* Runtime adaptation of rma_thresh and am_thresh */
+            ucp_ep_rndv_adapt_t adapt;
         } rndv;
 
         /* special thresholds for the ucp_tag_send_nbr() */
@@ -251,12 +274,16 @@ typedef struct ucp_ep_config {
         /* Protocols used for stream operations
          * (currently it's only AM based). */
         const ucp_proto_t   *proto;
+        /* Threshold for switching from eager to rendezvous */
+        size_t              rndv_thresh;
     } stream;
     
     struct {
         /* Protocols used for am operations */
         const ucp_proto_t *proto;
         const ucp_proto_t *reply_proto;
+        /* Threshold for switching from eager to rendezvous */
+        size_t            rndv_thresh;
     } am_u;
 
 } ucp_ep_config_t;
@@ -325,6 +352,9 @@ typedef struct {
         ucs_list_link_t           ready_list;    /* List entry in worker's EP list */
         ucs_queue_head_t          match_q;       /* Queue of receive data or requests,
                                                     depends on UCP_EP_FLAG_STREAM_HAS_DATA */
+        ucs_queue_head_t          rndv_q;        /* Queue of receive data which waits
+                                                    for a rendezvous to a staging
+                                                    buffer to complete */
     } stream;
 
     struct {
@@ -405,6 +435,11 @@ int ucp_ep_is_sockaddr_stub(ucp_ep_h ep);
 
 void ucp_ep_config_init(ucp_worker_h worker, ucp_ep_config_t *config);
 
+void ucp_ep_config_rndv_adapt_start(ucp_request_t *req, size_t *rma_thresh_p,
+                                    size_t *am_thresh_p);
+
+void ucp_ep_config_rndv_adapt_complete(ucp_request_t *req, ucs_status_t status);
+
 int ucp_ep_config_is_equal(const ucp_ep_config_key_t *key1,
                            const ucp_ep_config_key_t *key2);
 
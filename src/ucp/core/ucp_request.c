@@ -9,6 +9,7 @@
 #include "ucp_request.inl"
 
 #include <ucp/proto/proto.h>
+#include <ucp/tag/tag_match.inl>
 
 #include <ucs/datastruct/mpool.inl>
 #include <ucs/debug/debug.h>
@@ -100,6 +101,7 @@ UCS_PROFILE_FUNC_VOID(ucp_request_cancel, (worker, request),
                       ucp_worker_h worker, void *request)
 {
     ucp_request_t *req = (ucp_request_t*)request - 1;
+    ucp_tag_match_t *tm;
 
     if (req->flags & UCP_REQUEST_FLAG_COMPLETED) {
         return;
@@ -108,7 +110,10 @@ UCS_PROFILE_FUNC_VOID(ucp_request_cancel, (worker, request),
     if (req->flags & UCP_REQUEST_FLAG_EXPECTED) {
         UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
 
-        ucp_tag_exp_remove(&worker->tm, req);
+        tm = ucp_tag_match_get(worker, req->recv.tag.tag);
+        UCP_TAG_MATCH_PART_LOCK(worker, tm);
+        ucp_tag_exp_remove(tm, req);
+        UCP_TAG_MATCH_PART_UNLOCK(worker, tm);
         /* If tag posted to the transport need to wait its completion */
         if (!(req->flags & UCP_REQUEST_FLAG_OFFLOADED)) {
             ucp_request_complete_tag_recv(req, UCS_ERR_CANCELED);
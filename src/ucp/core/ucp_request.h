@@ -17,6 +17,7 @@
 #include <uct/api/uct.h>
 #include <ucs/datastruct/mpool.h>
 #include <ucs/datastruct/queue_types.h>
+#include <ucs/time/time_def.h>
 #include <ucp/dt/dt.h>
 #include <ucp/rma/rma.h>
 #include <ucp/wireup/wireup.h>
@@ -32,17 +33,20 @@
 enum {
     UCP_REQUEST_FLAG_COMPLETED            = UCS_BIT(0),
     UCP_REQUEST_FLAG_RELEASED             = UCS_BIT(1),
+    UCP_REQUEST_FLAG_RNDV_ADAPT_EAGER     = UCS_BIT(2),
     UCP_REQUEST_FLAG_EXPECTED             = UCS_BIT(3),
     UCP_REQUEST_FLAG_LOCAL_COMPLETED      = UCS_BIT(4),
     UCP_REQUEST_FLAG_REMOTE_COMPLETED     = UCS_BIT(5),
     UCP_REQUEST_FLAG_CALLBACK             = UCS_BIT(6),
     UCP_REQUEST_FLAG_RECV                 = UCS_BIT(7),
     UCP_REQUEST_FLAG_SYNC                 = UCS_BIT(8),
+    UCP_REQUEST_FLAG_RNDV_ADAPT_RNDV      = UCS_BIT(9),
     UCP_REQUEST_FLAG_OFFLOADED            = UCS_BIT(10),
     UCP_REQUEST_FLAG_BLOCK_OFFLOAD        = UCS_BIT(11),
     UCP_REQUEST_FLAG_STREAM_RECV_WAITALL  = UCS_BIT(12),
     UCP_REQUEST_FLAG_SEND_AM              = UCS_BIT(13),
     UCP_REQUEST_FLAG_SEND_TAG             = UCS_BIT(14),
+    UCP_REQUEST_FLAG_RNDV_CHUNK_FILL      = UCS_BIT(15),
 #if ENABLE_ASSERT
     UCP_REQUEST_FLAG_STREAM_RECV          = UCS_BIT(16),
     UCP_REQUEST_DEBUG_FLAG_EXTERNAL       = UCS_BIT(17)
@@ -81,7 +85,10 @@ enum {
                                                        uct and the ucp level am header must
                                                        be accounted for when releasing 
                                                        descriptors */
-    UCP_RECV_DESC_FLAG_AM_REPLY       = UCS_BIT(8)  /* AM that needed a reply */
+    UCP_RECV_DESC_FLAG_AM_REPLY       = UCS_BIT(8), /* AM that needed a reply */
+    UCP_RECV_DESC_FLAG_STREAM_DETACHED = UCS_BIT(9) /* Stream data which is still
+                                                       being received by rendezvous,
+                                                       but its endpoint was closed */
 };
 
 
@@ -90,7 +97,8 @@ enum {
  */
 enum {
     UCP_RDESC_HASH_LIST = 0,
-    UCP_RDESC_ALL_LIST  = 1
+    UCP_RDESC_ALL_LIST  = 1,
+    UCP_RDESC_MASK_LIST = 2
 };
 
 
@@ -228,6 +236,9 @@ struct ucp_request {
             ucp_lane_index_t      lane;     /* Lane on which this request is being sent */
             uct_pending_req_t     uct;      /* UCT pending request */
             ucp_mem_desc_t        *mdesc;
+            ucs_time_t            start_time; /* Start time of a send measured
+                                                 for rendezvous threshold
+                                                 adaptation */
         } send;
 
         /* "receive" part - used for tag_recv and stream_recv operations */
@@ -241,6 +252,22 @@ struct ucp_request {
             ucp_worker_t          *worker;
             uct_tag_context_t     uct_ctx;  /* Transport offload context */
 
+            union {
+                struct {
+                    uint16_t      id;       /* Id of a rendezvous active message */
+                    uint16_t      cb_flags; /* Flags to pass to the AM callback */
+                    ucp_ep_h      reply_ep; /* Endpoint to pass to the AM callback */
+                } am;
+
+                struct {
+                    ucp_ep_h      ep;       /* Endpoint the stream data arrives on */
+                    union {
+                        ucp_request_t   *req;   /* User request received in place */
+                        ucp_recv_desc_t *rdesc; /* Staging descriptor */
+                    };
+                } stream_rndv;
+            };
+
             union {
                 struct {
                     ucp_tag_t               tag;      /* Expected tag */
@@ -291,7 +318,7 @@ struct ucp_request {
  */
 struct ucp_recv_desc {
     union {
-        ucs_list_link_t     tag_list[2];    /* Hash list TAG-element */
+        ucs_list_link_t     tag_list[3];    /* Hash list TAG-element */
         ucs_queue_elem_t    stream_queue;   /* Queue STREAM-element */
         ucs_queue_elem_t    tag_frag_queue; /* Tag fragments queue */
     };
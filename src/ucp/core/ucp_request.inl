@@ -94,6 +94,10 @@ ucp_request_complete_send(ucp_request_t *req, ucs_status_t status)
                   req, req + 1, UCP_REQUEST_FLAGS_ARG(req->flags),
                   ucs_status_string(status));
     UCS_PROFILE_REQUEST_EVENT(req, "complete_send", status);
+    if (ucs_unlikely(req->flags & (UCP_REQUEST_FLAG_RNDV_ADAPT_EAGER |
+                                   UCP_REQUEST_FLAG_RNDV_ADAPT_RNDV))) {
+        ucp_ep_config_rndv_adapt_complete(req, status);
+    }
     ucp_request_complete(req, send.cb, status);
 }
 
@@ -518,11 +522,16 @@ static UCS_F_ALWAYS_INLINE void
 ucp_recv_desc_release(ucp_recv_desc_t *rdesc)
 {
     ucs_trace_req("release receive descriptor %p", rdesc);
-    if (ucs_unlikely(rdesc->flags & UCP_RECV_DESC_FLAG_UCT_DESC)) {
-        /* uct desc is slowpath */
-        uct_iface_release_desc(UCS_PTR_BYTE_OFFSET(rdesc,
-                                                   -(UCP_WORKER_HEADROOM_PRIV_SIZE -
-                                                     rdesc->priv_length)));
+    if (ucs_unlikely(rdesc->flags & (UCP_RECV_DESC_FLAG_UCT_DESC |
+                                     UCP_RECV_DESC_FLAG_MALLOC))) {
+        /* uct or malloc desc is slowpath */
+        if (rdesc->flags & UCP_RECV_DESC_FLAG_MALLOC) {
+            ucs_free(rdesc);
+        } else {
+            uct_iface_release_desc(UCS_PTR_BYTE_OFFSET(rdesc,
+                                                       -(UCP_WORKER_HEADROOM_PRIV_SIZE -
+                                                         rdesc->priv_length)));
+        }
     } else {
         ucs_mpool_put_inline(rdesc);
     }
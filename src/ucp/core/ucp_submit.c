@@ -0,0 +1,224 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2019.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+#include "ucp_submit.h"
+#include "ucp_request.inl"
+
+#include <ucp/api/ucp.h>
+#include <ucp/tag/tag_match.h>
+#include <ucs/arch/atomic.h>
+#include <ucs/datastruct/mpool.inl>
+#include <ucs/debug/log.h>
+#include <ucs/debug/memtrack.h>
+
+
+/* Maximal number of operations started by a single progress call */
+#define UCP_WORKER_SUBMIT_BATCH  16
+
+
+static UCS_F_ALWAYS_INLINE ucp_worker_h ucp_submit_req_worker(void *request)
+{
+    ucp_request_t *req = (ucp_request_t*)request - 1;
+    return ucs_container_of(ucs_mpool_obj_owner(req), ucp_worker_t, req_mp);
+}
+
+static UCS_F_ALWAYS_INLINE ucp_submit_req_priv_t *
+ucp_submit_req_priv(ucp_worker_h worker, void *request)
+{
+    return UCS_PTR_BYTE_OFFSET(request,
+                               ucp_submit_req_priv_offset(worker->context));
+}
+
+static void ucp_submit_complete(ucp_submit_callback_t cb, void *arg,
+                                ucs_status_t status,
+                                const ucp_tag_recv_info_t *info)
+{
+    if (cb != NULL) {
+        cb(arg, status, info);
+    }
+}
+
+static void ucp_submit_send_callback(void *request, ucs_status_t status)
+{
+    ucp_worker_h worker         = ucp_submit_req_worker(request);
+    ucp_submit_req_priv_t *priv = ucp_submit_req_priv(worker, request);
+
+    ucp_submit_complete(priv->cb, priv->arg, status, NULL);
+    ucp_request_free(request);
+}
+
+static void ucp_submit_recv_callback(void *request, ucs_status_t status,
+                                     ucp_tag_recv_info_t *info)
+{
+    ucp_worker_h worker         = ucp_submit_req_worker(request);
+    ucp_submit_req_priv_t *priv = ucp_submit_req_priv(worker, request);
+
+    ucp_submit_complete(priv->cb, priv->arg, status, info);
+    ucp_request_free(request);
+}
+
+static void ucp_submit_tag_recv(ucp_worker_h worker, const ucp_submit_op_t *op)
+{
+    ucp_submit_req_priv_t *priv;
+    ucs_status_t status;
+    ucp_request_t *req;
+
+    UCP_CONTEXT_CHECK_FEATURE_FLAGS(worker->context, UCP_FEATURE_TAG,
+                                    status = UCS_ERR_INVALID_PARAM; goto err);
+    UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
+
+    req = ucp_request_get(worker);
+    if (req == NULL) {
+        UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(worker);
+        status = UCS_ERR_NO_MEMORY;
+        goto err;
+    }
+
+    /* Save the completion before posting, since a matching unexpected
+     * message completes the request right away */
+    priv      = ucp_submit_req_priv(worker, req + 1);
+    priv->cb  = op->cb;
+    priv->arg = op->arg;
+    status    = ucp_tag_recv_post(worker, req, op->buffer, op->count,
+                                  op->datatype, op->tag, op->tag_mask,
+                                  ucp_submit_recv_callback);
+    if (status != UCS_OK) {
+        goto err_put_req;
+    }
+
+    UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(worker);
+    return;
+
+err_put_req:
+    ucp_request_put(req);
+    UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(worker);
+err:
+    ucp_submit_complete(op->cb, op->arg, status, NULL);
+}
+
+static void ucp_submit_start(ucp_worker_h worker, const ucp_submit_op_t *op)
+{
+    ucp_submit_req_priv_t *priv;
+    ucs_status_ptr_t status_p;
+
+    switch (op->type) {
+    case UCP_SUBMIT_OP_TAG_SEND:
+        status_p = ucp_tag_send_nb(op->ep, op->buffer, op->count, op->datatype,
+                                   op->tag, ucp_submit_send_callback);
+        break;
+    case UCP_SUBMIT_OP_TAG_RECV:
+        ucp_submit_tag_recv(worker, op);
+        return;
+    case UCP_SUBMIT_OP_PUT:
+        status_p = ucp_put_nb(op->ep, op->buffer, op->count, op->remote_addr,
+                              op->rkey, ucp_submit_send_callback);
+        break;
+    case UCP_SUBMIT_OP_GET:
+        status_p = ucp_get_nb(op->ep, op->buffer, op->count, op->remote_addr,
+                              op->rkey, ucp_submit_send_callback);
+        break;
+    default:
+        ucs_error("worker %p: invalid submitted operation type %d", worker,
+                  op->type);
+        status_p = UCS_STATUS_PTR(UCS_ERR_INVALID_PARAM);
+        break;
+    }
+
+    if (UCS_PTR_IS_PTR(status_p)) {
+        priv      = ucp_submit_req_priv(worker, status_p);
+        priv->cb  = op->cb;
+        priv->arg = op->arg;
+    } else {
+        ucp_submit_complete(op->cb, op->arg, UCS_PTR_STATUS(status_p), NULL);
+    }
+}
+
+unsigned ucp_worker_submit_dispatch(ucp_worker_h worker)
+{
+    ucp_submit_op_t ops[UCP_WORKER_SUBMIT_BATCH];
+    unsigned i, count;
+
+    /* Operations are started outside of the worker lock, so several threads
+     * may progress the worker at the same time. Let only one of them pull and
+     * start operations, to keep the submission order; the others leave the
+     * queue to the next progress call. */
+    if (ucs_atomic_cswap32(&worker->submit_busy, 0, 1) != 0) {
+        return 0;
+    }
+
+    count = ucs_mpmc_ring_pull_n(worker->submit_q, ops,
+                                 UCP_WORKER_SUBMIT_BATCH);
+    for (i = 0; i < count; ++i) {
+        ucp_submit_start(worker, &ops[i]);
+    }
+
+    ucs_memory_cpu_fence();
+    worker->submit_busy = 0;
+    return count;
+}
+
+ucs_status_t ucp_worker_submit(ucp_worker_h worker, const ucp_submit_op_t *op)
+{
+    ucs_status_t status;
+
+    if (worker->submit_q == NULL) {
+        return UCS_ERR_UNSUPPORTED;
+    }
+
+    status = ucs_mpmc_ring_push(worker->submit_q, op);
+    if (status != UCS_OK) {
+        return UCS_ERR_NO_RESOURCE;
+    }
+
+    ucp_worker_signal_internal(worker);
+    return UCS_OK;
+}
+
+ucs_status_t ucp_worker_submit_init(ucp_worker_h worker)
+{
+    unsigned length = worker->context->config.ext.submit_queue_len;
+    ucs_status_t status;
+
+    worker->submit_q    = NULL;
+    worker->submit_busy = 0;
+
+    if (length == 0) {
+        return UCS_OK;
+    }
+
+    worker->submit_q = ucs_memalign(UCS_SYS_CACHE_LINE_SIZE,
+                                    sizeof(*worker->submit_q), "submit_q");
+    if (worker->submit_q == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    status = ucs_mpmc_ring_init(worker->submit_q, length,
+                                sizeof(ucp_submit_op_t));
+    if (status != UCS_OK) {
+        ucs_free(worker->submit_q);
+        worker->submit_q = NULL;
+    }
+
+    return status;
+}
+
+void ucp_worker_submit_cleanup(ucp_worker_h worker)
+{
+    ucp_submit_op_t op;
+
+    if (worker->submit_q == NULL) {
+        return;
+    }
+
+    /* Operations which were never started are completed with an error */
+    while (ucs_mpmc_ring_pull(worker->submit_q, &op) == UCS_OK) {
+        ucp_submit_complete(op.cb, op.arg, UCS_ERR_CANCELED, NULL);
+    }
+
+    ucs_mpmc_ring_cleanup(worker->submit_q);
+    ucs_free(worker->submit_q);
+    worker->submit_q = NULL;
+}
@@ -0,0 +1,73 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2019.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+
+#ifndef UCP_SUBMIT_H_
+#define UCP_SUBMIT_H_
+
+#include "ucp_worker.h"
+
+#include <ucp/api/ucpx.h>
+
+#include <ucs/sys/math.h>
+
+
+/**
+ * Completion callback of a submitted operation, saved after the user-defined
+ * part of the request while the operation is in progress.
+ */
+typedef struct ucp_submit_req_priv {
+    ucp_submit_callback_t  cb;
+    void                   *arg;
+} ucp_submit_req_priv_t;
+
+
+/**
+ * @return Offset of @ref ucp_submit_req_priv_t from the user-defined part of
+ *         the request.
+ */
+static inline size_t ucp_submit_req_priv_offset(ucp_context_h context)
+{
+    return ucs_align_up_pow2(context->config.request.size, sizeof(void*));
+}
+
+
+/**
+ * @return Size of the user-defined part of the request, including the space
+ *         needed by the submission queue.
+ */
+static inline size_t ucp_submit_req_user_size(ucp_context_h context)
+{
+    if (context->config.ext.submit_queue_len == 0) {
+        return context->config.request.size;
+    }
+
+    return ucp_submit_req_priv_offset(context) + sizeof(ucp_submit_req_priv_t);
+}
+
+
+ucs_status_t ucp_worker_submit_init(ucp_worker_h worker);
+
+void ucp_worker_submit_cleanup(ucp_worker_h worker);
+
+unsigned ucp_worker_submit_dispatch(ucp_worker_h worker);
+
+
+/**
+ * Start the operations submitted by other threads.
+ */
+static UCS_F_ALWAYS_INLINE unsigned
+ucp_worker_submit_progress(ucp_worker_h worker)
+{
+    if (ucs_likely((worker->submit_q == NULL) ||
+                   ucs_mpmc_ring_is_empty(worker->submit_q))) {
+        return 0;
+    }
+
+    return ucp_worker_submit_dispatch(worker);
+}
+
+#endif
@@ -90,6 +90,10 @@ enum {
     UCP_AM_ID_SINGLE_REPLY      =  25, /* For user defined AM when a reply
                                           is needed */
     UCP_AM_ID_MULTI_REPLY       =  26,
+    UCP_AM_ID_AM_RTS            =  27, /* Ready-to-Send to init rendezvous of
+                                          a user defined AM */
+    UCP_AM_ID_STREAM_RTS        =  28, /* Ready-to-Send to init rendezvous of
+                                          STREAM data */
     UCP_AM_ID_LAST
 };
 
@@ -9,6 +9,7 @@
 #include "ucp_worker.h"
 #include "ucp_mm.h"
 #include "ucp_request.inl"
+#include "ucp_submit.h"
 
 #include <ucp/wireup/address.h>
 #include <ucp/wireup/wireup_ep.h>
@@ -39,7 +40,9 @@ static ucs_stats_class_t ucp_worker_stats_class = {
         [UCP_WORKER_STAT_TAG_RX_EAGER_CHUNK_EXP]   = "rx_eager_chunk_exp",
         [UCP_WORKER_STAT_TAG_RX_EAGER_CHUNK_UNEXP] = "rx_eager_chunk_unexp",
         [UCP_WORKER_STAT_TAG_RX_RNDV_EXP]          = "rx_rndv_rts_exp",
-        [UCP_WORKER_STAT_TAG_RX_RNDV_UNEXP]        = "rx_rndv_rts_unexp"
+        [UCP_WORKER_STAT_TAG_RX_RNDV_UNEXP]        = "rx_rndv_rts_unexp",
+        [UCP_WORKER_STAT_TAG_TX_RNDV_THRESH_INC]   = "tx_rndv_thresh_inc",
+        [UCP_WORKER_STAT_TAG_TX_RNDV_THRESH_DEC]   = "tx_rndv_thresh_dec"
     }
 };
 
@@ -311,6 +314,74 @@ static void ucp_worker_wakeup_cleanup(ucp_worker_h worker)
     }
 }
 
+static unsigned ucp_worker_tag_match_num_parts(ucp_worker_h worker)
+{
+    return UCS_BIT(worker->context->config.ext.tm_channel_bits);
+}
+
+static ucs_status_t ucp_worker_tag_match_init(ucp_worker_h worker)
+{
+    unsigned shift = worker->context->config.ext.tm_channel_shift;
+    ucp_tag_match_t *parts;
+    ucs_status_t status;
+    unsigned i;
+
+    worker->tm_parts      = NULL;
+    worker->tm_part_mask  = 0;
+    worker->tm_part_shift = shift;
+
+    status = ucp_tag_match_init(&worker->tm);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    if (worker->context->config.ext.tm_channel_bits == 0) {
+        return UCS_OK;
+    }
+
+    parts = ucs_calloc(ucp_worker_tag_match_num_parts(worker), sizeof(*parts),
+                       "ucp_tm_parts");
+    if (parts == NULL) {
+        status = UCS_ERR_NO_MEMORY;
+        goto err_cleanup_tm;
+    }
+
+    for (i = 0; i < ucp_worker_tag_match_num_parts(worker); ++i) {
+        status = ucp_tag_match_init(&parts[i]);
+        if (status != UCS_OK) {
+            goto err_cleanup_parts;
+        }
+    }
+
+    worker->tm_parts     = parts;
+    worker->tm_part_mask = (ucp_tag_t)(ucp_worker_tag_match_num_parts(worker) - 1)
+                           << shift;
+    return UCS_OK;
+
+err_cleanup_parts:
+    while (i-- > 0) {
+        ucp_tag_match_cleanup(&parts[i]);
+    }
+    ucs_free(parts);
+err_cleanup_tm:
+    ucp_tag_match_cleanup(&worker->tm);
+    return status;
+}
+
+static void ucp_worker_tag_match_cleanup(ucp_worker_h worker)
+{
+    unsigned i;
+
+    if (worker->tm_parts != NULL) {
+        for (i = 0; i < ucp_worker_tag_match_num_parts(worker); ++i) {
+            ucp_tag_match_cleanup(&worker->tm_parts[i]);
+        }
+        ucs_free(worker->tm_parts);
+    }
+
+    ucp_tag_match_cleanup(&worker->tm);
+}
+
 static void ucp_worker_iface_disarm(ucp_worker_iface_t *wiface)
 {
     ucs_status_t status;
@@ -1480,7 +1551,8 @@ ucs_status_t ucp_worker_create(ucp_context_h context,
 
     /* Create memory pool for requests */
     status = ucs_mpool_init(&worker->req_mp, 0,
-                            sizeof(ucp_request_t) + context->config.request.size,
+                            sizeof(ucp_request_t) +
+                            ucp_submit_req_user_size(context),
                             0, UCS_SYS_CACHE_LINE_SIZE, 128, UINT_MAX,
                             &ucp_request_mpool_ops, "ucp_requests");
     if (status != UCS_OK) {
@@ -1500,7 +1572,7 @@ ucs_status_t ucp_worker_create(ucp_context_h context,
     }
 
     /* Initialize tag matching */
-    status = ucp_tag_match_init(&worker->tm);
+    status = ucp_worker_tag_match_init(worker);
     if (status != UCS_OK) {
         goto err_wakeup_cleanup;
     }
@@ -1523,6 +1595,12 @@ ucs_status_t ucp_worker_create(ucp_context_h context,
         goto err_close_ifaces;
     }
 
+    /* Init queue of operations submitted by other threads */
+    status = ucp_worker_submit_init(worker);
+    if (status != UCS_OK) {
+        goto err_destroy_mpools;
+    }
+
     /* Select atomic resources */
     ucp_worker_init_atomic_tls(worker);
 
@@ -1534,9 +1612,13 @@ ucs_status_t ucp_worker_create(ucp_context_h context,
     *worker_p = worker;
     return UCS_OK;
 
+err_destroy_mpools:
+    ucs_mpool_cleanup(&worker->am_mp, 1);
+    ucs_mpool_cleanup(&worker->reg_mp, 1);
+    ucs_mpool_cleanup(&worker->rndv_frag_mp, 1);
 err_close_ifaces:
     ucp_worker_close_ifaces(worker);
-    ucp_tag_match_cleanup(&worker->tm);
+    ucp_worker_tag_match_cleanup(worker);
 err_wakeup_cleanup:
     ucp_worker_wakeup_cleanup(worker);
 err_req_mp_cleanup:
@@ -1570,6 +1652,7 @@ void ucp_worker_destroy(ucp_worker_h worker)
     ucs_trace_func("worker=%p", worker);
 
     UCS_ASYNC_BLOCK(&worker->async);
+    ucp_worker_submit_cleanup(worker);
     ucs_free(worker->am_cbs);
     ucp_worker_destroy_eps(worker);
     ucp_worker_remove_am_handlers(worker);
@@ -1579,7 +1662,7 @@ void ucp_worker_destroy(ucp_worker_h worker)
     ucs_mpool_cleanup(&worker->reg_mp, 1);
     ucs_mpool_cleanup(&worker->rndv_frag_mp, 1);
     ucp_worker_close_ifaces(worker);
-    ucp_tag_match_cleanup(&worker->tm);
+    ucp_worker_tag_match_cleanup(worker);
     ucp_worker_wakeup_cleanup(worker);
     ucs_mpool_cleanup(&worker->req_mp, 1);
     uct_worker_destroy(worker->uct);
@@ -1637,11 +1720,15 @@ unsigned ucp_worker_progress(ucp_worker_h worker)
     /* worker->inprogress is used only for assertion check.
      * coverity[assert_side_effect]
      */
+    /* Submitted operations are started by the same API functions the user
+     * would call, which take the worker lock by themselves */
+    count = ucp_worker_submit_progress(worker);
+
     UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
 
     /* check that ucp_worker_progress is not called from within ucp_worker_progress */
     ucs_assert(worker->inprogress++ == 0);
-    count = uct_worker_progress(worker->uct);
+    count += uct_worker_progress(worker->uct);
     ucs_async_check_miss(&worker->async);
 
     /* coverity[assert_side_effect] */
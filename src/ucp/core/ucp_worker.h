@@ -16,6 +16,7 @@
 #include <ucp/tag/tag_match.h>
 #include <ucp/wireup/ep_match.h>
 #include <ucs/datastruct/mpool.h>
+#include <ucs/datastruct/mpmc_ring.h>
 #include <ucs/datastruct/queue_types.h>
 #include <ucs/datastruct/strided_alloc.h>
 #include <ucs/arch/bitops.h>
@@ -96,6 +97,11 @@ enum {
 
     UCP_WORKER_STAT_TAG_RX_RNDV_EXP,
     UCP_WORKER_STAT_TAG_RX_RNDV_UNEXP,
+
+    /* Number of times an endpoint configuration adapted its rendezvous
+     * threshold up or down */
+    UCP_WORKER_STAT_TAG_TX_RNDV_THRESH_INC,
+    UCP_WORKER_STAT_TAG_TX_RNDV_THRESH_DEC,
     UCP_WORKER_STAT_LAST
 };
 
@@ -184,9 +190,10 @@ struct ucp_worker_iface {
  * Data that is stored about each callback registered with a worker
  */
 typedef struct ucp_worker_am_entry {
-    ucp_am_callback_t     cb;
-    void                 *context;
-    uint32_t              flags;
+    ucp_am_callback_t              cb;
+    ucp_am_recv_buffer_callback_t  buffer_cb; /* Provides buffers for large AMs */
+    void                          *context;
+    uint32_t                       flags;
 } ucp_worker_am_entry_t;
 
 /**
@@ -223,7 +230,14 @@ typedef struct ucp_worker {
     ucs_mpool_t                   reg_mp;        /* Registered memory pool */
     ucs_mpool_t                   rndv_frag_mp;  /* Memory pool for RNDV fragments */
     ucp_tag_match_t               tm;            /* Tag-matching queues and offload info */
+    ucp_tag_match_t               *tm_parts;     /* Tag-matching partitions, or NULL if
+                                                    matching is not partitioned */
+    ucp_tag_t                     tm_part_mask;  /* Tag bits which select a partition */
+    unsigned                      tm_part_shift; /* Offset of these bits in the tag */
     uint64_t                      am_message_id; /* For matching long am's */
+    ucs_mpmc_ring_t               *submit_q;     /* Operations submitted by other threads */
+    volatile uint32_t             submit_busy;   /* Set while a thread starts the
+                                                    submitted operations */
     ucp_ep_h                      mem_type_ep[UCT_MD_MEM_TYPE_LAST];/* memory type eps */
 
     UCS_STATS_NODE_DECLARE(stats);
@@ -10,6 +10,7 @@
 #include <ucp/core/ucp_request.h>
 #include <ucp/core/ucp_request.inl>
 #include <ucp/stream/stream.h>
+#include <ucp/tag/rndv.h>
 
 #include <ucs/datastruct/mpool.inl>
 #include <ucs/profile/profile.h>
@@ -121,6 +122,28 @@ UCS_PROFILE_FUNC(ucs_status_ptr_t, ucp_stream_recv_data_nb, (ep, length),
     return status_ptr;
 }
 
+UCS_PROFILE_FUNC(ssize_t, ucp_stream_recv_data_iov_nb, (ep, iov, iovcnt),
+                 ucp_ep_h ep, ucp_dt_iov_t *iov, size_t iovcnt)
+{
+    ucp_ep_ext_proto_t *ep_ext = ucp_ep_ext_proto(ep);
+    size_t             count;
+
+    UCP_CONTEXT_CHECK_FEATURE_FLAGS(ep->worker->context, UCP_FEATURE_STREAM,
+                                    return UCS_ERR_INVALID_PARAM);
+
+    UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(ep->worker);
+
+    for (count = 0; (count < iovcnt) && ucp_stream_ep_has_data(ep_ext);
+         ++count) {
+        iov[count].buffer = ucp_stream_recv_data_nb_nolock(ep,
+                                                           &iov[count].length);
+    }
+
+    UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(ep->worker);
+
+    return count;
+}
+
 static UCS_F_ALWAYS_INLINE void
 ucp_stream_rdesc_dequeue_and_release(ucp_recv_desc_t *rdesc,
                                      ucp_ep_ext_proto_t *ep_ext)
@@ -145,6 +168,20 @@ UCS_PROFILE_FUNC_VOID(ucp_stream_data_release, (ep, data),
     UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(ep->worker);
 }
 
+UCS_PROFILE_FUNC_VOID(ucp_stream_data_release_iov, (ep, iov, iovcnt),
+                      ucp_ep_h ep, const ucp_dt_iov_t *iov, size_t iovcnt)
+{
+    size_t i;
+
+    UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(ep->worker);
+
+    for (i = 0; i < iovcnt; ++i) {
+        ucp_recv_desc_release(ucp_stream_rdesc_from_data(iov[i].buffer));
+    }
+
+    UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(ep->worker);
+}
+
 static UCS_F_ALWAYS_INLINE ssize_t
 ucp_stream_rdata_unpack(const void *rdata, size_t length, ucp_request_t *dst_req)
 {
@@ -343,74 +380,138 @@ out:
     return req;
 }
 
-static UCS_F_ALWAYS_INLINE ucs_status_t
-ucp_stream_am_data_process(ucp_worker_t *worker, ucp_ep_ext_proto_t *ep_ext,
-                           ucp_stream_am_data_t *am_data, size_t length,
-                           unsigned am_flags)
+/* Fill expected requests with the data of 'rdesc', whose payload starts at
+ * 'base' + payload_offset. Returns nonzero if all data was consumed. */
+static UCS_F_ALWAYS_INLINE int
+ucp_stream_rdesc_process_exp(ucp_ep_ext_proto_t *ep_ext, ucp_recv_desc_t *rdesc,
+                             void *base)
 {
-    ucp_recv_desc_t  rdesc_tmp;
-    void            *payload;
-    ucp_recv_desc_t *rdesc;
-    ucp_request_t   *req;
-    ssize_t          unpacked;
+    void          *payload;
+    ucp_request_t *req;
+    ssize_t        unpacked;
 
-    rdesc_tmp.length         = length;
-    rdesc_tmp.payload_offset = sizeof(*am_data); /* add sizeof(*rdesc) only if
-                                                    am_data wont be handled in
-                                                    place */
+    if (ucp_stream_ep_has_data(ep_ext)) {
+        return 0;
+    }
 
-    /* First, process expected requests */
-    if (!ucp_stream_ep_has_data(ep_ext)) {
-        while (!ucs_queue_is_empty(&ep_ext->stream.match_q)) {
-            req      = ucs_queue_head_elem_non_empty(&ep_ext->stream.match_q,
-                                                     ucp_request_t, recv.queue);
-            payload  = UCS_PTR_BYTE_OFFSET(am_data, rdesc_tmp.payload_offset);
-            unpacked = ucp_stream_rdata_unpack(payload, rdesc_tmp.length, req);
-            if (ucs_unlikely(unpacked < 0)) {
-                ucs_fatal("failed to unpack from am_data %p with offset %u to request %p",
-                          am_data, rdesc_tmp.payload_offset, req);
-            } else if (unpacked == rdesc_tmp.length) {
-                if (ucp_request_can_complete_stream_recv(req)) {
-                    ucp_request_complete_stream_recv(req, ep_ext, UCS_OK);
-                }
-                return UCS_OK;
+    while (!ucs_queue_is_empty(&ep_ext->stream.match_q)) {
+        req      = ucs_queue_head_elem_non_empty(&ep_ext->stream.match_q,
+                                                 ucp_request_t, recv.queue);
+        payload  = UCS_PTR_BYTE_OFFSET(base, rdesc->payload_offset);
+        unpacked = ucp_stream_rdata_unpack(payload, rdesc->length, req);
+        if (ucs_unlikely(unpacked < 0)) {
+            ucs_fatal("failed to unpack from %p with offset %u to request %p",
+                      base, rdesc->payload_offset, req);
+        } else if (unpacked == rdesc->length) {
+            if (ucp_request_can_complete_stream_recv(req)) {
+                ucp_request_complete_stream_recv(req, ep_ext, UCS_OK);
             }
-            ucp_stream_rdesc_advance(&rdesc_tmp, unpacked, ep_ext);
-            /* This request is full, try next one */
-            ucs_assert(ucp_request_can_complete_stream_recv(req));
-            ucp_request_complete_stream_recv(req, ep_ext, UCS_OK);
+            return 1;
         }
+        ucp_stream_rdesc_advance(rdesc, unpacked, ep_ext);
+        /* This request is full, try next one */
+        ucs_assert(ucp_request_can_complete_stream_recv(req));
+        ucp_request_complete_stream_recv(req, ep_ext, UCS_OK);
     }
 
-    ucs_assert(rdesc_tmp.length > 0);
+    return 0;
+}
+
+static UCS_F_ALWAYS_INLINE ucp_recv_desc_t *
+ucp_stream_rdesc_init(ucp_worker_t *worker, ucp_stream_am_data_t *am_data,
+                      size_t length, uint32_t payload_offset, unsigned am_flags)
+{
+    ucp_recv_desc_t *rdesc;
+
+    ucs_assert(length > 0);
 
-    /* Now, enqueue the rest of data */
     if (ucs_likely(!(am_flags & UCT_CB_PARAM_FLAG_DESC))) {
         rdesc = (ucp_recv_desc_t*)ucs_mpool_get_inline(&worker->am_mp);
         ucs_assertv_always(rdesc != NULL,
                            "ucp recv descriptor is not allocated");
-        rdesc->length         = rdesc_tmp.length;
+        rdesc->length         = length;
         /* reset offset to improve locality */
         rdesc->payload_offset = sizeof(*rdesc) + sizeof(*am_data);
         rdesc->flags          = 0;
         memcpy(ucp_stream_rdesc_payload(rdesc),
-               UCS_PTR_BYTE_OFFSET(am_data, rdesc_tmp.payload_offset),
-               rdesc_tmp.length);
+               UCS_PTR_BYTE_OFFSET(am_data, payload_offset), length);
     } else {
         /* slowpath */
         rdesc                 = (ucp_recv_desc_t *)am_data - 1;
-        rdesc->length         = rdesc_tmp.length;
-        rdesc->payload_offset = rdesc_tmp.payload_offset + sizeof(*rdesc);
+        rdesc->length         = length;
+        rdesc->payload_offset = payload_offset + sizeof(*rdesc);
         rdesc->priv_length    = 0;
         rdesc->flags          = UCP_RECV_DESC_FLAG_UCT_DESC;
     }
 
+    return rdesc;
+}
+
+static UCS_F_ALWAYS_INLINE ucs_status_t
+ucp_stream_am_data_process(ucp_worker_t *worker, ucp_ep_ext_proto_t *ep_ext,
+                           ucp_stream_am_data_t *am_data, size_t length,
+                           unsigned am_flags)
+{
+    ucp_recv_desc_t  rdesc_tmp;
+    ucp_recv_desc_t *rdesc;
+
+    rdesc_tmp.length         = length;
+    rdesc_tmp.payload_offset = sizeof(*am_data); /* add sizeof(*rdesc) only if
+                                                    am_data wont be handled in
+                                                    place */
+
+    /* First, process expected requests */
+    if (ucp_stream_rdesc_process_exp(ep_ext, &rdesc_tmp, am_data)) {
+        return UCS_OK;
+    }
+
+    /* Now, enqueue the rest of data */
+    rdesc = ucp_stream_rdesc_init(worker, am_data, rdesc_tmp.length,
+                                  rdesc_tmp.payload_offset, am_flags);
+
     ucp_ep_from_ext_proto(ep_ext)->flags |= UCP_EP_FLAG_STREAM_HAS_DATA;
     ucs_queue_push(&ep_ext->stream.match_q, &rdesc->stream_queue);
 
     return UCS_INPROGRESS;
 }
 
+/* Hand over data which was held back behind a rendezvous */
+static void ucp_stream_rdesc_deliver(ucp_ep_h ep, ucp_recv_desc_t *rdesc)
+{
+    ucp_ep_ext_proto_t *ep_ext = ucp_ep_ext_proto(ep);
+
+    if ((ep->flags & UCP_EP_FLAG_CLOSED) || (rdesc->length == 0) ||
+        ucp_stream_rdesc_process_exp(ep_ext, rdesc, rdesc)) {
+        ucp_recv_desc_release(rdesc);
+        return;
+    }
+
+    ep->flags |= UCP_EP_FLAG_STREAM_HAS_DATA;
+    ucs_queue_push(&ep_ext->stream.match_q, &rdesc->stream_queue);
+
+    if (!ucp_stream_ep_is_queued(ep_ext) && (ep->flags & UCP_EP_FLAG_USED)) {
+        ucp_stream_ep_enqueue(ep_ext, ep->worker);
+    }
+}
+
+static void ucp_stream_rndv_q_progress(ucp_ep_h ep)
+{
+    ucp_ep_ext_proto_t *ep_ext = ucp_ep_ext_proto(ep);
+    ucp_recv_desc_t    *rdesc;
+
+    while (!ucs_queue_is_empty(&ep_ext->stream.rndv_q)) {
+        rdesc = ucs_queue_head_elem_non_empty(&ep_ext->stream.rndv_q,
+                                              ucp_recv_desc_t, stream_queue);
+        if (rdesc->flags & UCP_RECV_DESC_FLAG_RNDV) {
+            /* keep the order: wait for the rendezvous to complete */
+            break;
+        }
+
+        ucs_queue_pull_non_empty(&ep_ext->stream.rndv_q);
+        ucp_stream_rdesc_deliver(ep, rdesc);
+    }
+}
+
 void ucp_stream_ep_init(ucp_ep_h ep)
 {
     ucp_ep_ext_proto_t *ep_ext = ucp_ep_ext_proto(ep);
@@ -419,13 +520,16 @@ void ucp_stream_ep_init(ucp_ep_h ep)
         ep_ext->stream.ready_list.prev = NULL;
         ep_ext->stream.ready_list.next = NULL;
         ucs_queue_head_init(&ep_ext->stream.match_q);
+        ucs_queue_head_init(&ep_ext->stream.rndv_q);
     }
 }
 
 void ucp_stream_ep_cleanup(ucp_ep_h ep)
 {
-    size_t length;
-    void *data;
+    ucp_ep_ext_proto_t *ep_ext = ucp_ep_ext_proto(ep);
+    ucp_recv_desc_t    *rdesc;
+    size_t             length;
+    void               *data;
 
     if (ep->worker->context->config.features & UCP_FEATURE_STREAM) {
         while ((data = ucp_stream_recv_data_nb_nolock(ep, &length)) != NULL) {
@@ -433,6 +537,18 @@ void ucp_stream_ep_cleanup(ucp_ep_h ep)
             ucp_stream_data_release(ep, data);
         }
 
+        while (!ucs_queue_is_empty(&ep_ext->stream.rndv_q)) {
+            rdesc = ucs_queue_pull_elem_non_empty(&ep_ext->stream.rndv_q,
+                                                  ucp_recv_desc_t,
+                                                  stream_queue);
+            if (rdesc->flags & UCP_RECV_DESC_FLAG_RNDV) {
+                /* released by the rendezvous completion */
+                rdesc->flags |= UCP_RECV_DESC_FLAG_STREAM_DETACHED;
+            } else {
+                ucp_recv_desc_release(rdesc);
+            }
+        }
+
         if (ucp_stream_ep_is_queued(ucp_ep_ext_proto(ep))) {
             ucp_stream_ep_dequeue(ucp_ep_ext_proto(ep));
         }
@@ -457,6 +573,7 @@ ucp_stream_am_handler(void *am_arg, void *am_data, size_t am_length,
     ucp_stream_am_data_t *data      = am_data;
     ucp_ep_h              ep;
     ucp_ep_ext_proto_t    *ep_ext;
+    ucp_recv_desc_t       *rdesc;
     ucs_status_t          status;
 
     ucs_assert(am_length >= sizeof(ucp_stream_am_hdr_t));
@@ -470,6 +587,15 @@ ucp_stream_am_handler(void *am_arg, void *am_data, size_t am_length,
         return UCS_OK;
     }
 
+    if (ucs_unlikely(!ucs_queue_is_empty(&ep_ext->stream.rndv_q))) {
+        /* preserve the stream order behind an incomplete rendezvous */
+        rdesc = ucp_stream_rdesc_init(worker, data,
+                                      am_length - sizeof(data->hdr),
+                                      sizeof(*data), am_flags);
+        ucs_queue_push(&ep_ext->stream.rndv_q, &rdesc->stream_queue);
+        return (am_flags & UCT_CB_PARAM_FLAG_DESC) ? UCS_INPROGRESS : UCS_OK;
+    }
+
     status = ucp_stream_am_data_process(worker, ep_ext, data,
                                         am_length - sizeof(data->hdr),
                                         am_flags);
@@ -487,6 +613,157 @@ ucp_stream_am_handler(void *am_arg, void *am_data, size_t am_length,
     return (am_flags & UCT_CB_PARAM_FLAG_DESC) ? UCS_INPROGRESS : UCS_OK;
 }
 
+static void ucp_stream_rndv_recv_completion(void *request, ucs_status_t status,
+                                            ucp_tag_recv_info_t *info)
+{
+    ucp_request_t *rreq = (ucp_request_t*)request - 1;
+    ucp_request_t *req  = rreq->recv.stream_rndv.req;
+    size_t length       = (status == UCS_OK) ? info->length : 0;
+
+    req->recv.stream.offset = length;
+    req->recv.stream.length = length;
+    ucs_trace_req("completing stream rendezvous receive request %p (%p) "
+                  UCP_REQUEST_FLAGS_FMT" count %zu, %s",
+                  req, req + 1, UCP_REQUEST_FLAGS_ARG(req->flags), length,
+                  ucs_status_string(status));
+    UCS_PROFILE_REQUEST_EVENT(req, "complete_recv", status);
+    ucp_request_complete(req, recv.stream.cb, status, length);
+}
+
+static void ucp_stream_rndv_stage_completion(void *request, ucs_status_t status,
+                                             ucp_tag_recv_info_t *info)
+{
+    ucp_request_t   *rreq  = (ucp_request_t*)request - 1;
+    ucp_recv_desc_t *rdesc = rreq->recv.stream_rndv.rdesc;
+
+    if (rdesc->flags & UCP_RECV_DESC_FLAG_STREAM_DETACHED) {
+        ucp_recv_desc_release(rdesc);
+        return;
+    }
+
+    if (ucs_unlikely(status != UCS_OK)) {
+        ucs_error("failed to receive stream rendezvous data: %s",
+                  ucs_status_string(status));
+        rdesc->length = 0;
+    }
+
+    rdesc->flags &= ~UCP_RECV_DESC_FLAG_RNDV;
+    ucp_stream_rndv_q_progress(rreq->recv.stream_rndv.ep);
+}
+
+/* Whether the head expected request can take the whole rendezvous data of
+ * 'length' bytes directly into the user buffer */
+static UCS_F_ALWAYS_INLINE int
+ucp_stream_rndv_is_inplace(ucp_ep_ext_proto_t *ep_ext, size_t length)
+{
+    ucp_request_t *req;
+
+    if (!ucs_queue_is_empty(&ep_ext->stream.rndv_q) ||
+        ucp_stream_ep_has_data(ep_ext) ||
+        ucs_queue_is_empty(&ep_ext->stream.match_q)) {
+        return 0;
+    }
+
+    req = ucs_queue_head_elem_non_empty(&ep_ext->stream.match_q,
+                                        ucp_request_t, recv.queue);
+    if ((req->recv.stream.offset != 0) ||
+        !UCP_DT_IS_CONTIG(req->recv.datatype)) {
+        return 0;
+    }
+
+    return (req->recv.length == length) ||
+           ((req->recv.length > length) &&
+            !(req->flags & UCP_REQUEST_FLAG_STREAM_RECV_WAITALL) &&
+            ((length % ucp_contig_dt_elem_size(req->recv.datatype)) == 0));
+}
+
+static ucs_status_t
+ucp_stream_rts_handler(void *am_arg, void *am_data, size_t am_length,
+                       unsigned am_flags)
+{
+    ucp_worker_h       worker        = am_arg;
+    ucp_rndv_rts_hdr_t *rndv_rts_hdr = am_data;
+    size_t             length        = rndv_rts_hdr->size;
+    ucp_ep_h           ep;
+    ucp_ep_ext_proto_t *ep_ext;
+    ucp_recv_desc_t    *rdesc;
+    ucp_request_t      *rreq;
+    ucp_request_t      *req;
+
+    ep     = ucp_worker_get_ep_by_ptr(worker, rndv_rts_hdr->sreq.ep_ptr);
+    ep_ext = ucp_ep_ext_proto(ep);
+
+    rreq = ucp_request_get(worker);
+    if (rreq == NULL) {
+        ucs_error("failed to allocate stream rendezvous receive request");
+        return UCS_OK;
+    }
+
+    rreq->flags              = UCP_REQUEST_FLAG_RECV | UCP_REQUEST_FLAG_CALLBACK |
+                               UCP_REQUEST_FLAG_RELEASED;
+    rreq->recv.worker        = worker;
+    rreq->recv.stream_rndv.ep = ep;
+
+    if (ucs_unlikely(ep->flags & UCP_EP_FLAG_CLOSED)) {
+        ucs_trace_data("ep %p: stream is invalid", ep);
+        goto drop;
+    } else if (ucp_stream_rndv_is_inplace(ep_ext, length)) {
+        /* receive directly to the user buffer */
+fprintf(stderr, "DBGSR zcopy %zu\n", length);
+        req = ucs_queue_pull_elem_non_empty(&ep_ext->stream.match_q,
+                                            ucp_request_t, recv.queue);
+        rreq->recv.stream_rndv.req = req;
+        rreq->recv.tag.cb          = ucp_stream_rndv_recv_completion;
+        rreq->recv.buffer          = req->recv.buffer;
+        rreq->recv.datatype        = req->recv.datatype;
+        rreq->recv.mem_type        = req->recv.mem_type;
+        rreq->recv.length          = req->recv.length;
+        rreq->recv.state           = req->recv.state;
+        goto out;
+    } else if (ucs_unlikely(length > UINT32_MAX)) {
+        ucs_error("stream rendezvous of %zu bytes exceeds the staging limit",
+                  length);
+        goto drop;
+    }
+
+    /* stage the data, to be delivered in order when it arrives */
+fprintf(stderr, "DBGSR stage %zu\n", length);
+    rdesc = ucs_malloc(sizeof(*rdesc) + sizeof(ucp_stream_am_data_t) + length,
+                       "ucp stream rndv rdesc");
+    if (rdesc == NULL) {
+        ucs_error("failed to allocate %zu bytes for stream rendezvous", length);
+        goto drop;
+    }
+
+    rdesc->length         = length;
+    rdesc->payload_offset = sizeof(*rdesc) + sizeof(ucp_stream_am_data_t);
+    rdesc->flags          = UCP_RECV_DESC_FLAG_MALLOC | UCP_RECV_DESC_FLAG_RNDV;
+    rdesc->priv_length    = 0;
+    ucs_queue_push(&ep_ext->stream.rndv_q, &rdesc->stream_queue);
+
+    rreq->recv.stream_rndv.rdesc = rdesc;
+    rreq->recv.tag.cb            = ucp_stream_rndv_stage_completion;
+    rreq->recv.buffer            = ucp_stream_rdesc_payload(rdesc);
+    rreq->recv.length            = length;
+    goto out_init;
+
+drop:
+    /* a zero-length receive completes the sender as truncated */
+    rreq->flags      &= ~UCP_REQUEST_FLAG_CALLBACK;
+    rreq->recv.buffer = NULL;
+    rreq->recv.length = 0;
+
+out_init:
+    rreq->recv.datatype = ucp_dt_make_contig(1);
+    rreq->recv.mem_type = UCT_MD_MEM_TYPE_HOST;
+    ucp_dt_recv_state_init(&rreq->recv.state, rreq->recv.buffer,
+                           rreq->recv.datatype, rreq->recv.length);
+
+out:
+    ucp_rndv_matched(worker, rreq, rndv_rts_hdr);
+    return UCS_OK;
+}
+
 static void ucp_stream_am_dump(ucp_worker_h worker, uct_am_trace_type_t type,
                                uint8_t id, const void *data, size_t length,
                                char *buffer, size_t max)
@@ -506,4 +783,8 @@ static void ucp_stream_am_dump(ucp_worker_h worker, uct_am_trace_type_t type,
 UCP_DEFINE_AM(UCP_FEATURE_STREAM, UCP_AM_ID_STREAM_DATA, ucp_stream_am_handler,
               ucp_stream_am_dump, 0);
 
+UCP_DEFINE_AM(UCP_FEATURE_STREAM, UCP_AM_ID_STREAM_RTS, ucp_stream_rts_handler,
+              NULL, 0);
+
 UCP_DEFINE_AM_PROXY(UCP_AM_ID_STREAM_DATA);
+UCP_DEFINE_AM_PROXY(UCP_AM_ID_STREAM_RTS);
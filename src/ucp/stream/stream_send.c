@@ -11,6 +11,7 @@
 #include <ucp/proto/proto.h>
 #include <ucp/proto/proto_am.inl>
 #include <ucp/stream/stream.h>
+#include <ucp/tag/rndv.h>
 #include <ucp/dt/dt.h>
 #include <ucp/dt/dt.inl>
 
@@ -42,19 +43,62 @@ static void ucp_stream_send_req_init(ucp_request_t* req, ucp_ep_h ep,
     VALGRIND_MAKE_MEM_UNDEFINED(&req->send.tag, sizeof(req->send.tag));
 }
 
+static size_t ucp_stream_rndv_rts_pack(void *dest, void *arg)
+{
+    ucp_request_t      *sreq         = arg;
+    ucp_rndv_rts_hdr_t *rndv_rts_hdr = dest;
+
+    rndv_rts_hdr->super.tag = 0; /* not used by stream */
+    return ucp_rndv_rts_pack(sreq, rndv_rts_hdr);
+}
+
+static ucs_status_t ucp_stream_progress_rndv_rts(uct_pending_req_t *self)
+{
+    return ucp_do_am_bcopy_single(self, UCP_AM_ID_STREAM_RTS,
+                                  ucp_stream_rndv_rts_pack);
+}
+
+static ucs_status_t ucp_stream_send_start_rndv(ucp_request_t *sreq)
+{
+    ucs_status_t status;
+
+    ucp_trace_req(sreq, "start stream rndv to %s buffer %p length %zu",
+                  ucp_ep_peer_name(sreq->send.ep), sreq->send.buffer,
+                  sreq->send.length);
+
+    /* the receiver fetches the data like for a tagged rendezvous, and
+     * acknowledges with the same ATS message */
+    status = ucp_rndv_send_buffer_reg(sreq);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    sreq->send.uct.func = ucp_stream_progress_rndv_rts;
+    return UCS_OK;
+}
+
 static UCS_F_ALWAYS_INLINE ucs_status_ptr_t
 ucp_stream_send_req(ucp_request_t *req, size_t count,
                     const ucp_ep_msg_config_t* msg_config,
                     ucp_send_callback_t cb, const ucp_proto_t *proto)
 {
+    size_t rndv_thresh  = ucp_ep_config(req->send.ep)->stream.rndv_thresh;
     size_t zcopy_thresh = ucp_proto_get_zcopy_threshold(req, msg_config,
-                                                        count, SIZE_MAX);
+                                                        count, rndv_thresh);
     ssize_t max_short   = ucp_proto_get_short_max(req, msg_config);
 
     ucs_status_t status = ucp_request_send_start(req, max_short, zcopy_thresh,
-                                                 SIZE_MAX, count, msg_config,
+                                                 rndv_thresh, count, msg_config,
                                                  proto);
-    if (status != UCS_OK) {
+    if (status == UCS_ERR_NO_PROGRESS) {
+        ucs_assert(req->send.length >= rndv_thresh);
+        status = ucp_stream_send_start_rndv(req);
+        if (status != UCS_OK) {
+            return UCS_STATUS_PTR(status);
+        }
+
+        UCP_EP_STAT_TAG_OP(req->send.ep, RNDV);
+    } else if (status != UCS_OK) {
         return UCS_STATUS_PTR(status);
     }
 
@@ -41,13 +41,17 @@ ucp_eager_offload_handler(void *arg, void *data, size_t length,
                           unsigned tl_flags, uint16_t flags, ucp_tag_t recv_tag)
 {
     ucp_worker_t *worker = arg;
+    ucp_tag_match_t *tm  = ucp_tag_match_get(worker, recv_tag);
     ucp_request_t *req;
     ucp_recv_desc_t *rdesc;
     ucp_tag_t *rdesc_hdr;
     ucs_status_t status;
 
-    req = ucp_tag_exp_search(&worker->tm, recv_tag);
+    UCP_TAG_MATCH_PART_LOCK(worker, tm);
+
+    req = ucp_tag_exp_search(tm, recv_tag);
     if (req != NULL) {
+        UCP_TAG_MATCH_PART_UNLOCK(worker, tm);
         ucp_eager_expected_handler(worker, req, data, length, recv_tag, flags);
         req->recv.tag.info.length = length;
         status = ucp_request_recv_data_unpack(req, data, length, 0, 1);
@@ -60,8 +64,9 @@ ucp_eager_offload_handler(void *arg, void *data, size_t length,
         if (!UCS_STATUS_IS_ERR(status)) {
             rdesc_hdr  = (ucp_tag_t*)(rdesc + 1);
             *rdesc_hdr = recv_tag;
-            ucp_tag_unexp_recv(&worker->tm, rdesc, recv_tag);
+            ucp_tag_unexp_recv(tm, rdesc, recv_tag);
         }
+        UCP_TAG_MATCH_PART_UNLOCK(worker, tm);
     }
 
     return status;
@@ -75,6 +80,7 @@ ucp_eager_tagged_handler(void *arg, void *data, size_t length, unsigned am_flags
     ucp_eager_hdr_t *eager_hdr = data;
     ucp_eager_first_hdr_t *eagerf_hdr;
     ucp_recv_desc_t *rdesc;
+    ucp_tag_match_t *tm;
     ucp_request_t *req;
     ucs_status_t status;
     ucp_tag_t recv_tag;
@@ -85,9 +91,13 @@ ucp_eager_tagged_handler(void *arg, void *data, size_t length, unsigned am_flags
 
     recv_tag = eager_hdr->super.tag;
     recv_len = length - hdr_len;
+    tm       = ucp_tag_match_get(worker, recv_tag);
+
+    UCP_TAG_MATCH_PART_LOCK(worker, tm);
 
-    req = ucp_tag_exp_search(&worker->tm, recv_tag);
+    req = ucp_tag_exp_search(tm, recv_tag);
     if (req != NULL) {
+        UCP_TAG_MATCH_PART_UNLOCK(worker, tm);
         ucp_eager_expected_handler(worker, req, data, recv_len, recv_tag, flags);
 
         if (flags & UCP_RECV_DESC_FLAG_EAGER_SYNC) {
@@ -117,8 +127,9 @@ ucp_eager_tagged_handler(void *arg, void *data, size_t length, unsigned am_flags
         status = ucp_recv_desc_init(worker, data, length, 0, am_flags, hdr_len,
                                     flags, priv_length, &rdesc);
         if (!UCS_STATUS_IS_ERR(status)) {
-            ucp_tag_unexp_recv(&worker->tm, rdesc, recv_tag);
+            ucp_tag_unexp_recv(tm, rdesc, recv_tag);
         }
+        UCP_TAG_MATCH_PART_UNLOCK(worker, tm);
     }
 
     return status;
@@ -154,11 +165,12 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_eager_middle_handler,
     ucp_request_t *req;
     ucs_status_t status;
     size_t recv_len;
-    khiter_t iter;
+    ucs_flat_hash_iter_t iter;
     int ret;
 
-    iter   = kh_put(ucp_tag_frag_hash, &worker->tm.frag_hash, hdr->msg_id, &ret);
-    matchq = &kh_value(&worker->tm.frag_hash, iter);
+    iter   = ucs_flat_hash_put(ucp_tag_frag_hash, &worker->tm.frag_hash,
+                               hdr->msg_id, &ret);
+    matchq = &ucs_flat_hash_value(&worker->tm.frag_hash, iter);
     if (ret != 0) {
         /* initialize a previously empty hash entry */
         ucp_tag_frag_match_init_unexp(matchq);
@@ -182,7 +194,7 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_eager_middle_handler,
                                                    recv_len, hdr->offset, 0);
         if (status != UCS_INPROGRESS) {
             /* request completed, delete hash entry */
-            kh_del(ucp_tag_frag_hash, &worker->tm.frag_hash, iter);
+            ucs_flat_hash_del(ucp_tag_frag_hash, &worker->tm.frag_hash, iter);
         }
 
         status = UCS_OK;
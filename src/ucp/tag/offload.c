@@ -48,7 +48,7 @@ int ucp_tag_offload_iface_activate(ucp_worker_iface_t *iface)
 static UCS_F_ALWAYS_INLINE ucp_worker_iface_t*
 ucp_tag_offload_iface(ucp_worker_t *worker, ucp_tag_t tag)
 {
-    khiter_t hash_it;
+    ucs_flat_hash_iter_t hash_it;
     ucp_tag_t key_tag;
 
     if (worker->num_active_ifaces == 1) {
@@ -57,11 +57,11 @@ ucp_tag_offload_iface(ucp_worker_t *worker, ucp_tag_t tag)
     }
 
     key_tag = worker->context->config.tag_sender_mask & tag;
-    hash_it = kh_get(ucp_tag_offload_hash, &worker->tm.offload.tag_hash,
-                     key_tag);
+    hash_it = ucs_flat_hash_get(ucp_tag_offload_hash,
+                                &worker->tm.offload.tag_hash, key_tag);
 
-    return (hash_it == kh_end(&worker->tm.offload.tag_hash)) ?
-           NULL : kh_value(&worker->tm.offload.tag_hash, hash_it);
+    return (hash_it == ucs_flat_hash_end(&worker->tm.offload.tag_hash)) ?
+           NULL : ucs_flat_hash_value(&worker->tm.offload.tag_hash, hash_it);
 }
 
 static UCS_F_ALWAYS_INLINE void
@@ -79,10 +79,20 @@ UCS_PROFILE_FUNC_VOID(ucp_tag_offload_tag_consumed, (self),
                       uct_tag_context_t *self)
 {
     ucp_request_t *req = ucs_container_of(self, ucp_request_t, recv.uct_ctx);
+    ucp_tag_match_t *tm = &req->recv.worker->tm;
+    ucp_request_queue_t *req_queue;
     ucs_queue_head_t *queue;
-
-    queue = &ucp_tag_exp_get_req_queue(&req->recv.worker->tm, req)->queue;
-    ucs_queue_remove(queue, &req->recv.queue);
+    ucs_queue_iter_t iter;
+    ucp_request_t *qreq;
+
+    req_queue = ucp_tag_exp_get_req_queue(tm, req);
+    queue     = ucp_tag_exp_req_list(tm, req_queue, req);
+    ucs_queue_for_each_safe(qreq, iter, queue, recv.queue) {
+        if (qreq == req) {
+            ucp_tag_exp_queue_remove(tm, req_queue, req, iter);
+            return;
+        }
+    }
 }
 
 /* Message is scattered to user buffer by the transport, complete the request */
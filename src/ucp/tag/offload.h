@@ -73,16 +73,17 @@ int ucp_tag_offload_post(ucp_request_t *req, ucp_request_queue_t *req_queue);
 int ucp_tag_offload_iface_activate(ucp_worker_iface_t *wiface);
 
 static UCS_F_ALWAYS_INLINE void
-ucp_tag_offload_try_post(ucp_worker_t *worker, ucp_request_t *req,
+ucp_tag_offload_try_post(ucp_tag_match_t *tm, ucp_request_t *req,
                          ucp_request_queue_t *req_queue)
 {
-    if (ucs_unlikely(req->recv.length >= worker->tm.offload.thresh)) {
+    /* Offload is never activated on tag-matching partitions */
+    if (ucs_unlikely(req->recv.length >= tm->offload.thresh)) {
         if (ucp_tag_offload_post(req, req_queue)) {
             return;
         }
     }
 
-    ++worker->tm.expected.sw_all_count;
+    ++tm->expected.sw_all_count;
     ++req_queue->sw_count;
     req_queue->block_count += !!(req->flags & UCP_REQUEST_FLAG_BLOCK_OFFLOAD);
 }
@@ -120,7 +121,7 @@ ucp_tag_offload_unexp(ucp_worker_iface_t *wiface, ucp_tag_t tag, size_t length)
 {
     ucp_worker_t *worker = wiface->worker;
     ucp_tag_t tag_key;
-    khiter_t hash_it;
+    ucs_flat_hash_iter_t hash_it;
     int ret;
 
     ++wiface->proxy_recv_count;
@@ -134,12 +135,13 @@ ucp_tag_offload_unexp(ucp_worker_iface_t *wiface, ucp_tag_t tag, size_t length)
     if (ucs_unlikely((length >= worker->tm.offload.thresh) &&
                      (worker->num_active_ifaces > 1))) {
         tag_key = worker->context->config.tag_sender_mask & tag;
-        hash_it = kh_put(ucp_tag_offload_hash, &worker->tm.offload.tag_hash,
-                         tag_key, &ret);
+        hash_it = ucs_flat_hash_put(ucp_tag_offload_hash,
+                                    &worker->tm.offload.tag_hash, tag_key,
+                                    &ret);
 
-        /* khash returns 1 or 2 if key is not present and value can be set */
+        /* 1 is returned if key is not present and value can be set */
         if (ret > 0) {
-            kh_value(&worker->tm.offload.tag_hash, hash_it) = wiface;
+            ucs_flat_hash_value(&worker->tm.offload.tag_hash, hash_it) = wiface;
         }
     }
 }
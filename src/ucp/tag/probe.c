@@ -19,16 +19,28 @@ ucp_tag_message_h ucp_tag_probe_nb(ucp_worker_h worker, ucp_tag_t tag,
 {
     ucp_context_h UCS_V_UNUSED context = worker->context;
     ucp_recv_desc_t *rdesc;
+    ucp_tag_match_t *tm;
     uint16_t flags;
 
     UCP_CONTEXT_CHECK_FEATURE_FLAGS(worker->context, UCP_FEATURE_TAG,
                                     return NULL);
-    UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
+
+    if (ucp_tag_match_check_mask(worker, tag_mask) != UCS_OK) {
+        return NULL;
+    }
+
+    /* A partition is protected by its own lock instead of the worker lock */
+    tm = ucp_tag_match_get(worker, tag);
+    if (tm == &worker->tm) {
+        UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
+    } else {
+        UCP_TAG_MATCH_PART_LOCK(worker, tm);
+    }
 
     ucs_trace_req("probe_nb tag %"PRIx64"/%"PRIx64" remove=%d", tag, tag_mask,
                   remove);
 
-    rdesc = ucp_tag_unexp_search(&worker->tm, tag, tag_mask, remove, "probe");
+    rdesc = ucp_tag_unexp_search(tm, tag, tag_mask, remove, "probe");
     if (rdesc != NULL) {
         flags            = rdesc->flags;
         info->sender_tag = ucp_rdesc_get_tag(rdesc);
@@ -43,7 +55,11 @@ ucp_tag_message_h ucp_tag_probe_nb(ucp_worker_h worker, ucp_tag_t tag,
         }
     }
 
-    UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(worker);
+    if (tm == &worker->tm) {
+        UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(worker);
+    } else {
+        UCP_TAG_MATCH_PART_UNLOCK(worker, tm);
+    }
 
     return rdesc;
 }
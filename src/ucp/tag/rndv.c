@@ -20,14 +20,12 @@ static int ucp_rndv_is_get_zcopy(ucp_request_t *sreq, ucp_rndv_mode_t rndv_mode)
               UCP_MEM_IS_ROCM(sreq->send.mem_type))));
 }
 
-size_t ucp_tag_rndv_rts_pack(void *dest, void *arg)
+/* Pack the RTS fields which follow the tag or the active message header */
+size_t ucp_rndv_rts_pack(ucp_request_t *sreq, ucp_rndv_rts_hdr_t *rndv_rts_hdr)
 {
-    ucp_request_t *sreq              = arg;   /* send request */
-    ucp_rndv_rts_hdr_t *rndv_rts_hdr = dest;
-    ucp_worker_h worker              = sreq->send.ep->worker;
+    ucp_worker_h worker = sreq->send.ep->worker;
     ssize_t packed_rkey_size;
 
-    rndv_rts_hdr->super.tag        = sreq->send.tag.tag;
     rndv_rts_hdr->sreq.reqptr      = (uintptr_t)sreq;
     rndv_rts_hdr->sreq.ep_ptr      = ucp_request_get_dest_ep_ptr(sreq);
     rndv_rts_hdr->size             = sreq->send.length;
@@ -54,6 +52,15 @@ size_t ucp_tag_rndv_rts_pack(void *dest, void *arg)
     return sizeof(*rndv_rts_hdr) + packed_rkey_size;
 }
 
+size_t ucp_tag_rndv_rts_pack(void *dest, void *arg)
+{
+    ucp_request_t *sreq              = arg;   /* send request */
+    ucp_rndv_rts_hdr_t *rndv_rts_hdr = dest;
+
+    rndv_rts_hdr->super.tag = sreq->send.tag.tag;
+    return ucp_rndv_rts_pack(sreq, rndv_rts_hdr);
+}
+
 UCS_PROFILE_FUNC(ucs_status_t, ucp_proto_progress_rndv_rts, (self),
                  uct_pending_req_t *self)
 {
@@ -105,10 +112,23 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_proto_progress_rndv_rtr, (self),
     return status;
 }
 
+ucs_status_t ucp_rndv_send_buffer_reg(ucp_request_t *sreq)
+{
+    ucp_ep_h ep = sreq->send.ep;
+
+    if (UCP_DT_IS_CONTIG(sreq->send.datatype) &&
+        ucp_rndv_is_get_zcopy(sreq, ep->worker->context->config.ext.rndv_mode)) {
+        /* register a contiguous buffer for rma_get */
+        return ucp_request_send_buffer_reg(sreq,
+                                           ucp_ep_config(ep)->key.rma_bw_md_map);
+    }
+
+    return UCS_OK;
+}
+
 ucs_status_t ucp_tag_send_start_rndv(ucp_request_t *sreq)
 {
     ucp_ep_h ep = sreq->send.ep;
-    ucp_md_map_t md_map;
     ucs_status_t status;
 
     ucp_trace_req(sreq, "start_rndv to %s buffer %p length %zu",
@@ -127,14 +147,9 @@ ucs_status_t ucp_tag_send_start_rndv(ucp_request_t *sreq)
             return status;
         }
     } else {
-        if (UCP_DT_IS_CONTIG(sreq->send.datatype) &&
-            ucp_rndv_is_get_zcopy(sreq, ep->worker->context->config.ext.rndv_mode)) {
-            /* register a contiguous buffer for rma_get */
-            md_map = ucp_ep_config(ep)->key.rma_bw_md_map;
-            status = ucp_request_send_buffer_reg(sreq, md_map);
-            if (status != UCS_OK) {
-                return status;
-            }
+        status = ucp_rndv_send_buffer_reg(sreq);
+        if (status != UCS_OK) {
+            return status;
         }
 
         ucs_assert(sreq->send.lane == ucp_ep_get_am_lane(ep));
@@ -411,7 +426,8 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_rndv_progress_rma_get_zcopy, (self),
                                        status);
         if (rndv_req->send.state.dt.offset == rndv_req->send.length) {
             if (rndv_req->send.state.uct_comp.count == 0) {
-                ucp_rndv_complete_rma_get_zcopy(rndv_req);
+                rndv_req->send.state.uct_comp.func(&rndv_req->send.state.uct_comp,
+                                                   status);
             }
             return UCS_OK;
         } else if (!UCS_STATUS_IS_ERR(status)) {
@@ -457,10 +473,162 @@ static void ucp_rndv_put_completion(uct_completion_t *self, ucs_status_t status)
     }
 }
 
+static int ucp_rndv_is_chunked(ucp_request_t *req)
+{
+    return UCP_MEM_IS_HOST(req->send.mem_type) &&
+           (req->send.length >
+            req->send.ep->worker->context->config.ext.rndv_chunk_size);
+}
+
+static void ucp_rndv_chunk_get_completion(uct_completion_t *self,
+                                          ucs_status_t status);
+
+static void ucp_rndv_chunk_put_completion(uct_completion_t *self,
+                                          ucs_status_t status);
+
+/*
+ * Reuse the request 'chunk' to transfer the next chunk of the rendezvous
+ * request 'req'. The chunk registers only its own part of the local buffer.
+ */
+static void ucp_rndv_chunk_send(ucp_request_t *req, ucp_request_t *chunk,
+                                unsigned proto)
+{
+    ucp_context_h context = req->send.ep->worker->context;
+    size_t offset         = req->send.state.dt.offset;
+    size_t length;
+
+    length = ucs_min(context->config.ext.rndv_chunk_size,
+                     req->send.length - offset);
+
+    ucp_request_send_state_init(chunk, ucp_dt_make_contig(1), 0);
+    chunk->flags             = 0;
+    chunk->send.ep           = req->send.ep;
+    chunk->send.buffer       = UCS_PTR_BYTE_OFFSET(req->send.buffer, offset);
+    chunk->send.datatype     = ucp_dt_make_contig(1);
+    chunk->send.mem_type     = req->send.mem_type;
+    chunk->send.length       = length;
+    chunk->send.mdesc        = NULL;
+    chunk->send.pending_lane = UCP_NULL_LANE;
+
+    if (proto == UCP_REQUEST_SEND_PROTO_RNDV_GET) {
+        ucp_request_send_state_reset(chunk, ucp_rndv_chunk_get_completion,
+                                     UCP_REQUEST_SEND_PROTO_RNDV_GET);
+        chunk->send.uct.func                = ucp_rndv_progress_rma_get_zcopy;
+        chunk->send.rndv_get.remote_address = req->send.rndv_get.remote_address +
+                                              offset;
+        chunk->send.rndv_get.rreq           = req;
+        chunk->send.rndv_get.rkey           = req->send.rndv_get.rkey;
+        chunk->send.rndv_get.lanes_map      = 0;
+        chunk->send.rndv_get.lane_count     = 0;
+    } else {
+        ucp_request_send_state_reset(chunk, ucp_rndv_chunk_put_completion,
+                                     UCP_REQUEST_SEND_PROTO_RNDV_PUT);
+        chunk->send.uct.func                = ucp_rndv_progress_rma_put_zcopy;
+        chunk->send.lane                    = req->send.lane;
+        chunk->send.rndv_put.remote_address = req->send.rndv_put.remote_address +
+                                              offset;
+        chunk->send.rndv_put.sreq           = req;
+        chunk->send.rndv_put.rkey           = req->send.rndv_put.rkey;
+        chunk->send.rndv_put.uct_rkey       = req->send.rndv_put.uct_rkey;
+    }
+
+    ucs_trace_req("req %p: chunk %p offset %zu length %zu", req, chunk, offset,
+                  length);
+
+    req->send.state.dt.offset += length;
+    ++req->send.state.uct_comp.count;
+    ucp_request_send(chunk, 0);
+}
+
+/*
+ * Start chunks of the rendezvous request 'req' until the window is full, and
+ * complete it after the last chunk. The uct completion counter of 'req' counts
+ * its chunks in flight. 'chunk' is a request of a completed chunk to reuse, or
+ * NULL.
+ */
+static void ucp_rndv_chunks_progress(ucp_request_t *req, ucp_request_t *chunk,
+                                     unsigned proto)
+{
+    ucp_worker_h worker = req->send.ep->worker;
+    unsigned window     = worker->context->config.ext.rndv_chunk_window;
+
+    if (req->flags & UCP_REQUEST_FLAG_RNDV_CHUNK_FILL) {
+        /* A chunk completed right away while the window is being filled, the
+         * loop below will start the next one */
+        if (chunk != NULL) {
+            ucp_request_put(chunk);
+        }
+        return;
+    }
+
+    req->flags |= UCP_REQUEST_FLAG_RNDV_CHUNK_FILL;
+    while ((req->send.state.dt.offset < req->send.length) &&
+           (req->send.state.uct_comp.count < window)) {
+        if (chunk == NULL) {
+            chunk = ucp_request_get(worker);
+            if (chunk == NULL) {
+                if (req->send.state.uct_comp.count > 0) {
+                    /* continue when a chunk in flight completes */
+                    break;
+                }
+                ucs_fatal("failed to allocate rendezvous chunk request");
+            }
+        }
+
+        ucp_rndv_chunk_send(req, chunk, proto);
+        chunk = NULL;
+    }
+    req->flags &= ~UCP_REQUEST_FLAG_RNDV_CHUNK_FILL;
+
+    if (chunk != NULL) {
+        ucp_request_put(chunk);
+    }
+
+    if ((req->send.state.dt.offset == req->send.length) &&
+        (req->send.state.uct_comp.count == 0)) {
+        req->send.state.uct_comp.func(&req->send.state.uct_comp, UCS_OK);
+    }
+}
+
+static void ucp_rndv_chunk_completion(ucp_request_t *chunk, ucp_request_t *req,
+                                      unsigned proto)
+{
+    ucs_assert(req->send.state.uct_comp.count > 0);
+
+    ucp_request_send_buffer_dereg(chunk);
+    --req->send.state.uct_comp.count;
+    ucp_rndv_chunks_progress(req, chunk, proto);
+}
+
+static void ucp_rndv_chunk_get_completion(uct_completion_t *self,
+                                          ucs_status_t status)
+{
+    ucp_request_t *chunk = ucs_container_of(self, ucp_request_t,
+                                            send.state.uct_comp);
+
+    if (chunk->send.state.dt.offset == chunk->send.length) {
+        ucp_rndv_chunk_completion(chunk, chunk->send.rndv_get.rreq,
+                                  UCP_REQUEST_SEND_PROTO_RNDV_GET);
+    }
+}
+
+static void ucp_rndv_chunk_put_completion(uct_completion_t *self,
+                                          ucs_status_t status)
+{
+    ucp_request_t *chunk = ucs_container_of(self, ucp_request_t,
+                                            send.state.uct_comp);
+
+    if (chunk->send.state.dt.offset == chunk->send.length) {
+        ucp_rndv_chunk_completion(chunk, chunk->send.rndv_put.sreq,
+                                  UCP_REQUEST_SEND_PROTO_RNDV_PUT);
+    }
+}
+
 static void ucp_rndv_req_send_rma_get(ucp_request_t *rndv_req, ucp_request_t *rreq,
                                       const ucp_rndv_rts_hdr_t *rndv_rts_hdr)
 {
     ucs_status_t status;
+    uct_rkey_t uct_rkey;
 
     ucp_trace_req(rndv_req, "start rma_get rreq %p", rreq);
 
@@ -487,6 +655,15 @@ static void ucp_rndv_req_send_rma_get(ucp_request_t *rndv_req, ucp_request_t *rr
     ucp_request_send_state_reset(rndv_req, ucp_rndv_get_completion,
                                  UCP_REQUEST_SEND_PROTO_RNDV_GET);
 
+    if (ucp_rndv_is_chunked(rndv_req) &&
+        (ucp_rkey_get_rma_bw_lane(rndv_req->send.rndv_get.rkey,
+                                  rndv_req->send.ep, rndv_req->send.mem_type,
+                                  &uct_rkey, 0) != UCP_NULL_LANE)) {
+        ucp_trace_req(rndv_req, "start chunked rma_get");
+        ucp_rndv_chunks_progress(rndv_req, NULL, UCP_REQUEST_SEND_PROTO_RNDV_GET);
+        return;
+    }
+
     ucp_request_send(rndv_req, 0);
 }
 
@@ -567,12 +744,17 @@ ucs_status_t ucp_rndv_process_rts(void *arg, void *data, size_t length,
 {
     ucp_worker_h worker                = arg;
     ucp_rndv_rts_hdr_t *rndv_rts_hdr   = data;
+    ucp_tag_match_t *tm                = ucp_tag_match_get(worker,
+                                                           rndv_rts_hdr->super.tag);
     ucp_recv_desc_t *rdesc;
     ucp_request_t *rreq;
     ucs_status_t status;
 
-    rreq = ucp_tag_exp_search(&worker->tm, rndv_rts_hdr->super.tag);
+    UCP_TAG_MATCH_PART_LOCK(worker, tm);
+
+    rreq = ucp_tag_exp_search(tm, rndv_rts_hdr->super.tag);
     if (rreq != NULL) {
+        UCP_TAG_MATCH_PART_UNLOCK(worker, tm);
         ucp_rndv_matched(worker, rreq, rndv_rts_hdr);
 
         /* Cancel req in transport if it was offloaded, because it arrived
@@ -586,8 +768,9 @@ ucs_status_t ucp_rndv_process_rts(void *arg, void *data, size_t length,
                                     sizeof(*rndv_rts_hdr),
                                     UCP_RECV_DESC_FLAG_RNDV, 0, &rdesc);
         if (!UCS_STATUS_IS_ERR(status)) {
-            ucp_tag_unexp_recv(&worker->tm, rdesc, rndv_rts_hdr->super.tag);
+            ucp_tag_unexp_recv(tm, rdesc, rndv_rts_hdr->super.tag);
         }
+        UCP_TAG_MATCH_PART_UNLOCK(worker, tm);
     }
 
     return status;
@@ -951,6 +1134,12 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_rndv_rtr_handler,
             sreq->send.rndv_put.remote_request = rndv_rtr_hdr->rreq_ptr;
             sreq->send.rndv_put.remote_address = rndv_rtr_hdr->address;
             sreq->send.mdesc                   = NULL;
+            if (ucp_rndv_is_chunked(sreq)) {
+                ucp_trace_req(sreq, "start chunked rma_put");
+                ucp_rndv_chunks_progress(sreq, NULL,
+                                         UCP_REQUEST_SEND_PROTO_RNDV_PUT);
+                return UCS_OK;
+            }
             goto out_send;
         } else {
             ucp_rkey_destroy(sreq->send.rndv_put.rkey);
@@ -1065,13 +1254,17 @@ static void ucp_rndv_dump(ucp_worker_h worker, uct_am_trace_type_t type,
 
 UCP_DEFINE_AM(UCP_FEATURE_TAG, UCP_AM_ID_RNDV_RTS, ucp_rndv_rts_handler,
               ucp_rndv_dump, 0);
-UCP_DEFINE_AM(UCP_FEATURE_TAG, UCP_AM_ID_RNDV_ATS, ucp_rndv_ats_handler,
+UCP_DEFINE_AM(UCP_FEATURE_TAG | UCP_FEATURE_STREAM | UCP_FEATURE_EXPERIMENTAL,
+              UCP_AM_ID_RNDV_ATS, ucp_rndv_ats_handler,
               ucp_rndv_dump, 0);
-UCP_DEFINE_AM(UCP_FEATURE_TAG, UCP_AM_ID_RNDV_ATP, ucp_rndv_atp_handler,
+UCP_DEFINE_AM(UCP_FEATURE_TAG | UCP_FEATURE_STREAM | UCP_FEATURE_EXPERIMENTAL,
+              UCP_AM_ID_RNDV_ATP, ucp_rndv_atp_handler,
               ucp_rndv_dump, 0);
-UCP_DEFINE_AM(UCP_FEATURE_TAG, UCP_AM_ID_RNDV_RTR, ucp_rndv_rtr_handler,
+UCP_DEFINE_AM(UCP_FEATURE_TAG | UCP_FEATURE_STREAM | UCP_FEATURE_EXPERIMENTAL,
+              UCP_AM_ID_RNDV_RTR, ucp_rndv_rtr_handler,
               ucp_rndv_dump, 0);
-UCP_DEFINE_AM(UCP_FEATURE_TAG, UCP_AM_ID_RNDV_DATA, ucp_rndv_data_handler,
+UCP_DEFINE_AM(UCP_FEATURE_TAG | UCP_FEATURE_STREAM | UCP_FEATURE_EXPERIMENTAL,
+              UCP_AM_ID_RNDV_DATA, ucp_rndv_data_handler,
               ucp_rndv_dump, 0);
 
 UCP_DEFINE_AM_PROXY(UCP_AM_ID_RNDV_RTS);
@@ -10,6 +10,7 @@
 #include "tag_match.h"
 
 #include <ucp/api/ucp.h>
+#include <ucp/core/ucp_am.h>
 #include <ucp/core/ucp_request.h>
 #include <ucp/core/ucp_ep.inl>
 #include <ucp/proto/proto.h>
@@ -19,7 +20,11 @@
  * Rendezvous RTS
  */
 typedef struct {
-    ucp_tag_hdr_t             super;
+    union {
+        ucp_tag_hdr_t         super;    /* tag of a tagged message */
+        ucp_am_hdr_t          am;       /* header of an active message, the
+                                           length is in the size field */
+    };
     ucp_request_hdr_t         sreq;     /* send request on the rndv initiator side */
     uint64_t                  address;  /* holds the address of the data buffer on the sender's side */
     size_t                    size;     /* size of the data for sending */
@@ -47,14 +52,20 @@ typedef struct {
 
 ucs_status_t ucp_tag_send_start_rndv(ucp_request_t *req);
 
+ucs_status_t ucp_rndv_send_buffer_reg(ucp_request_t *sreq);
+
 void ucp_rndv_matched(ucp_worker_h worker, ucp_request_t *req,
                       const ucp_rndv_rts_hdr_t *rndv_rts_hdr);
 
 ucs_status_t ucp_rndv_progress_rma_get_zcopy(uct_pending_req_t *self);
 
+ucs_status_t ucp_rndv_progress_rma_put_zcopy(uct_pending_req_t *self);
+
 ucs_status_t ucp_rndv_process_rts(void *arg, void *data, size_t length,
                                   unsigned tl_flags);
 
+size_t ucp_rndv_rts_pack(ucp_request_t *sreq, ucp_rndv_rts_hdr_t *rndv_rts_hdr);
+
 size_t ucp_tag_rndv_rts_pack(void *dest, void *arg);
 
 #endif
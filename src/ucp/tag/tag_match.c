@@ -8,52 +8,303 @@
 #include <ucp/tag/offload.h>
 
 
+/* Tag hash tables start with 1024 buckets, which fit in L1 cache, and grow up
+ * to 1M buckets with the number of outstanding tags */
+#define UCP_TAG_MATCH_HASH_MIN_ORDER    10
+#define UCP_TAG_MATCH_HASH_MAX_ORDER    20
+
+/* Grow the table when the average bucket length exceeds this value, and
+ * shrink it when the table is less than 1/8 full */
+#define UCP_TAG_MATCH_HASH_MAX_LOAD     2
+#define UCP_TAG_MATCH_HASH_MIN_LOAD_DIV 8
+
+/* Number of old buckets moved to the new table by every queue insertion
+ * during a resize */
+#define UCP_TAG_MATCH_REHASH_STEP       16
+
+/* Index the unexpected queue by a search mask after it got this many more
+ * votes than other masks of searches which could not use the index */
+#define UCP_TAG_MATCH_MASK_INDEX_VOTES  8
+
+
+static void ucp_tag_hash_state_set(ucp_tag_hash_state_t *state, unsigned order)
+{
+    size_t size = UCS_BIT(order);
+
+    state->shift         = 64 - order;
+    state->grow_thresh   = (order < UCP_TAG_MATCH_HASH_MAX_ORDER) ?
+                           (size * UCP_TAG_MATCH_HASH_MAX_LOAD) : SIZE_MAX;
+    state->shrink_thresh = (order > UCP_TAG_MATCH_HASH_MIN_ORDER) ?
+                           (size / UCP_TAG_MATCH_HASH_MIN_LOAD_DIV) : 0;
+}
+
+static void ucp_tag_hash_state_init(ucp_tag_hash_state_t *state)
+{
+    state->old_shift  = 0;
+    state->rehash_idx = 0;
+    state->count      = 0;
+    ucp_tag_hash_state_set(state, UCP_TAG_MATCH_HASH_MIN_ORDER);
+}
+
+/* Order of the table to resize to, called when a threshold is crossed */
+static unsigned ucp_tag_hash_new_order(const ucp_tag_hash_state_t *state)
+{
+    unsigned order = 64 - state->shift;
+
+    return (state->count > state->grow_thresh) ? (order + 1) : (order - 1);
+}
+
+static void *ucp_tag_exp_hash_alloc(unsigned order)
+{
+    size_t size = UCS_BIT(order);
+    ucp_request_queue_t *hash;
+    size_t bucket;
+
+    hash = ucs_malloc(sizeof(*hash) * size, "ucp_tm_exp_hash");
+    if (hash == NULL) {
+        return NULL;
+    }
+
+    for (bucket = 0; bucket < size; ++bucket) {
+        hash[bucket].sw_count    = 0;
+        hash[bucket].block_count = 0;
+        ucs_queue_head_init(&hash[bucket].queue);
+    }
+
+    return hash;
+}
+
+static void *ucp_tag_unexp_hash_alloc(unsigned order)
+{
+    size_t size = UCS_BIT(order);
+    ucs_list_link_t *hash;
+    size_t bucket;
+
+    hash = ucs_malloc(sizeof(*hash) * size, "ucp_tm_unexp_hash");
+    if (hash == NULL) {
+        return NULL;
+    }
+
+    for (bucket = 0; bucket < size; ++bucket) {
+        ucs_list_head_init(&hash[bucket]);
+    }
+
+    return hash;
+}
+
 ucs_status_t ucp_tag_match_init(ucp_tag_match_t *tm)
 {
-    size_t hash_size, bucket;
+    ucs_status_t status;
 
-    hash_size = ucs_roundup_pow2(UCP_TAG_MATCH_HASH_SIZE);
+    status = ucs_spinlock_init(&tm->lock);
+    if (status != UCS_OK) {
+        return status;
+    }
 
     tm->expected.sn           = 0;
     tm->expected.sw_all_count = 0;
+    tm->expected.old_hash     = NULL;
+    tm->expected.wild_count   = 0;
     ucs_queue_head_init(&tm->expected.wildcard.queue);
+    ucp_tag_hash_state_init(&tm->expected.hash_state);
+    memset(tm->expected.mask_index, 0, sizeof(tm->expected.mask_index));
+
+    tm->unexpected.old_hash   = NULL;
     ucs_list_head_init(&tm->unexpected.all);
+    ucp_tag_hash_state_init(&tm->unexpected.hash_state);
+    memset(&tm->unexpected.mask_index, 0, sizeof(tm->unexpected.mask_index));
 
-    tm->expected.hash = ucs_malloc(sizeof(*tm->expected.hash) * hash_size,
-                                   "ucp_tm_exp_hash");
+    tm->expected.hash = ucp_tag_exp_hash_alloc(UCP_TAG_MATCH_HASH_MIN_ORDER);
     if (tm->expected.hash == NULL) {
-        return UCS_ERR_NO_MEMORY;
+        status = UCS_ERR_NO_MEMORY;
+        goto err_destroy_lock;
     }
 
-    tm->unexpected.hash = ucs_malloc(sizeof(*tm->unexpected.hash) * hash_size,
-                                     "ucp_tm_unexp_hash");
+    tm->unexpected.hash = ucp_tag_unexp_hash_alloc(UCP_TAG_MATCH_HASH_MIN_ORDER);
     if (tm->unexpected.hash == NULL) {
-        ucs_free(tm->expected.hash);
-        return UCS_ERR_NO_MEMORY;
+        status = UCS_ERR_NO_MEMORY;
+        goto err_free_exp_hash;
     }
 
-    for (bucket = 0; bucket < hash_size; ++bucket) {
-        tm->expected.hash[bucket].sw_count    = 0;
-        tm->expected.hash[bucket].block_count = 0;
-        ucs_queue_head_init(&tm->expected.hash[bucket].queue);
-        ucs_list_head_init(&tm->unexpected.hash[bucket]);
-    }
-
-    kh_init_inplace(ucp_tag_frag_hash, &tm->frag_hash);
+    ucs_flat_hash_init(ucp_tag_frag_hash, &tm->frag_hash);
     ucs_queue_head_init(&tm->offload.sync_reqs);
-    kh_init_inplace(ucp_tag_offload_hash, &tm->offload.tag_hash);
+    ucs_flat_hash_init(ucp_tag_offload_hash, &tm->offload.tag_hash);
     tm->offload.thresh       = SIZE_MAX;
     tm->offload.zcopy_thresh = SIZE_MAX;
     tm->offload.iface        = NULL;
     return UCS_OK;
+
+err_free_exp_hash:
+    ucs_free(tm->expected.hash);
+err_destroy_lock:
+    ucs_spinlock_destroy(&tm->lock);
+    return status;
 }
 
 void ucp_tag_match_cleanup(ucp_tag_match_t *tm)
 {
-    kh_destroy_inplace(ucp_tag_offload_hash, &tm->offload.tag_hash);
-    kh_destroy_inplace(ucp_tag_frag_hash, &tm->frag_hash);
+    ucp_tag_exp_mask_index_t *index;
+
+    for (index = tm->expected.mask_index;
+         index < tm->expected.mask_index + UCP_TAG_MATCH_MASK_INDEX_MAX;
+         ++index) {
+        ucs_free(index->hash);
+    }
+
+    ucs_free(tm->unexpected.mask_index.hash);
+    ucs_flat_hash_destroy(ucp_tag_offload_hash, &tm->offload.tag_hash);
+    ucs_flat_hash_destroy(ucp_tag_frag_hash, &tm->frag_hash);
+    ucs_free(tm->unexpected.old_hash);
     ucs_free(tm->unexpected.hash);
+    ucs_free(tm->expected.old_hash);
     ucs_free(tm->expected.hash);
+    ucs_spinlock_destroy(&tm->lock);
+}
+
+/*
+ * Start a resize if a threshold was crossed and no resize is in progress.
+ * Returns 0 if the table should not be resized now.
+ */
+static int ucp_tag_hash_rehash_start(ucp_tag_hash_state_t *state,
+                                     void **hash_p, void **old_hash_p,
+                                     void *(*alloc)(unsigned order))
+{
+    unsigned order;
+    void *hash;
+
+    if (*old_hash_p != NULL) {
+        return 1;
+    }
+
+    order = ucp_tag_hash_new_order(state);
+    hash  = alloc(order);
+    if (hash == NULL) {
+        /* Keep using the current table */
+        ucs_debug("failed to resize tag hash to %lu buckets", UCS_BIT(order));
+        return 0;
+    }
+
+    ucs_trace("resizing tag hash %p from %lu to %lu buckets (count %zu)",
+              state, UCS_BIT(64 - state->shift), UCS_BIT(order), state->count);
+
+    *old_hash_p       = *hash_p;
+    *hash_p           = hash;
+    state->old_shift  = state->shift;
+    state->rehash_idx = 0;
+    ucp_tag_hash_state_set(state, order);
+    return 1;
+}
+
+/* Complete the resize if all old buckets were moved */
+static void ucp_tag_hash_rehash_end(ucp_tag_hash_state_t *state,
+                                    void **old_hash_p)
+{
+    if (state->rehash_idx == UCS_BIT(64 - state->old_shift)) {
+        ucs_free(*old_hash_p);
+        *old_hash_p = NULL;
+    }
+}
+
+/*
+ * Return the old bucket whose head request should be moved next, or NULL if
+ * both are empty. When shrinking, two old buckets are merged into one new
+ * bucket, so take the requests in order of sequence number to keep the new
+ * bucket sorted like a bucket which was never resized.
+ */
+static ucp_request_queue_t *
+ucp_tag_exp_rehash_next(ucp_request_queue_t *queue0, ucp_request_queue_t *queue1)
+{
+    ucp_request_t *req0, *req1;
+
+    if ((queue1 == NULL) || ucs_queue_is_empty(&queue1->queue)) {
+        return ucs_queue_is_empty(&queue0->queue) ? NULL : queue0;
+    } else if (ucs_queue_is_empty(&queue0->queue)) {
+        return queue1;
+    }
+
+    req0 = ucs_queue_head_elem_non_empty(&queue0->queue, ucp_request_t,
+                                         recv.queue);
+    req1 = ucs_queue_head_elem_non_empty(&queue1->queue, ucp_request_t,
+                                         recv.queue);
+    return (req1->recv.tag.sn < req0->recv.tag.sn) ? queue1 : queue0;
+}
+
+void ucp_tag_exp_rehash(ucp_tag_match_t *tm)
+{
+    ucp_tag_hash_state_t *state = &tm->expected.hash_state;
+    ucp_request_queue_t *old_queue, *new_queue, *queue0, *queue1;
+    unsigned i, num_old;
+    ucp_request_t *req;
+
+    if (!ucp_tag_hash_rehash_start(state, (void**)&tm->expected.hash,
+                                   (void**)&tm->expected.old_hash,
+                                   ucp_tag_exp_hash_alloc)) {
+        return;
+    }
+
+    /* When shrinking, old buckets 2*i and 2*i+1 are moved together to new
+     * bucket i. The step size is even, so no request can be added to the new
+     * bucket between moving the two. */
+    num_old = (state->shift > state->old_shift) ? 2 : 1;
+    for (i = 0; (i < UCP_TAG_MATCH_REHASH_STEP) &&
+                (state->rehash_idx < UCS_BIT(64 - state->old_shift));
+         i += num_old) {
+        queue0             = &tm->expected.old_hash[state->rehash_idx];
+        queue1             = (num_old == 2) ? (queue0 + 1) : NULL;
+        state->rehash_idx += num_old;
+
+        while ((old_queue = ucp_tag_exp_rehash_next(queue0, queue1)) != NULL) {
+            req       = ucs_queue_pull_elem_non_empty(&old_queue->queue,
+                                                      ucp_request_t,
+                                                      recv.queue);
+            new_queue = &tm->expected.hash[
+                    ucp_tag_match_calc_hash(req->recv.tag.tag) >> state->shift];
+            if (!(req->flags & UCP_REQUEST_FLAG_OFFLOADED)) {
+                --old_queue->sw_count;
+                ++new_queue->sw_count;
+                if (req->flags & UCP_REQUEST_FLAG_BLOCK_OFFLOAD) {
+                    --old_queue->block_count;
+                    ++new_queue->block_count;
+                }
+            }
+            ucs_queue_push(&new_queue->queue, &req->recv.queue);
+        }
+
+        ucs_assert(queue0->sw_count == 0);
+        ucs_assert(queue0->block_count == 0);
+    }
+
+    ucp_tag_hash_rehash_end(state, (void**)&tm->expected.old_hash);
+}
+
+void ucp_tag_unexp_rehash(ucp_tag_match_t *tm)
+{
+    ucp_tag_hash_state_t *state = &tm->unexpected.hash_state;
+    ucs_list_link_t *old_list;
+    ucp_recv_desc_t *rdesc;
+    unsigned i;
+
+    if (!ucp_tag_hash_rehash_start(state, (void**)&tm->unexpected.hash,
+                                   (void**)&tm->unexpected.old_hash,
+                                   ucp_tag_unexp_hash_alloc)) {
+        return;
+    }
+
+    for (i = 0; (i < UCP_TAG_MATCH_REHASH_STEP) &&
+                (state->rehash_idx < UCS_BIT(64 - state->old_shift)); ++i) {
+        old_list = &tm->unexpected.old_hash[state->rehash_idx++];
+        while (!ucs_list_is_empty(old_list)) {
+            rdesc = ucs_list_head(old_list, ucp_recv_desc_t,
+                                  tag_list[UCP_RDESC_HASH_LIST]);
+            ucs_list_del(&rdesc->tag_list[UCP_RDESC_HASH_LIST]);
+            ucs_list_add_tail(&tm->unexpected.hash[
+                                  ucp_tag_match_calc_hash(
+                                      ucp_rdesc_get_tag(rdesc)) >> state->shift],
+                              &rdesc->tag_list[UCP_RDESC_HASH_LIST]);
+        }
+    }
+
+    ucp_tag_hash_rehash_end(state, (void**)&tm->unexpected.old_hash);
 }
 
 int ucp_tag_unexp_is_empty(ucp_tag_match_t *tm)
@@ -64,10 +315,11 @@ int ucp_tag_unexp_is_empty(ucp_tag_match_t *tm)
 void ucp_tag_exp_remove(ucp_tag_match_t *tm, ucp_request_t *req)
 {
     ucp_request_queue_t *req_queue = ucp_tag_exp_get_req_queue(tm, req);
+    ucs_queue_head_t *queue        = ucp_tag_exp_req_list(tm, req_queue, req);
     ucs_queue_iter_t iter;
     ucp_request_t *qreq;
 
-    ucs_queue_for_each_safe(qreq, iter, &req_queue->queue, recv.queue) {
+    ucs_queue_for_each_safe(qreq, iter, queue, recv.queue) {
         if (qreq == req) {
             ucp_tag_offload_try_cancel(req->recv.worker, req, 0);
             ucp_tag_exp_delete(req, tm, req_queue, iter);
@@ -78,58 +330,227 @@ void ucp_tag_exp_remove(ucp_tag_match_t *tm, ucp_request_t *req)
     ucs_bug("expected request not found");
 }
 
-static inline uint64_t ucp_tag_exp_req_seq(ucs_queue_iter_t iter)
+/* Find the first request in the queue which matches the tag */
+static ucp_request_t *ucp_tag_exp_queue_find(ucs_queue_head_t *queue,
+                                             ucp_tag_t tag,
+                                             ucs_queue_iter_t *iter_p)
+{
+    ucs_queue_iter_t iter;
+    ucp_request_t *req;
+
+    ucs_queue_for_each_safe(req, iter, queue, recv.queue) {
+        if (ucp_tag_is_match(tag, req->recv.tag.tag, req->recv.tag.tag_mask)) {
+            *iter_p = iter;
+            return req;
+        }
+    }
+
+    return NULL;
+}
+
+static ucs_queue_head_t *
+ucp_tag_exp_mask_index_queue(ucp_tag_exp_mask_index_t *index, ucp_tag_t tag)
 {
-    return (*iter == NULL) ? ULONG_MAX :
-           ucs_container_of(*iter, ucp_request_t, recv.queue)->recv.tag.sn;
+    return &index->hash[ucp_tag_mask_index_bucket(tag, index->tag_mask)];
 }
 
 ucp_request_t*
 ucp_tag_exp_search_all(ucp_tag_match_t *tm, ucp_request_queue_t *req_queue,
                        ucp_tag_t tag)
 {
-    ucs_queue_head_t *hash_queue = &req_queue->queue;
-    ucp_request_queue_t *queue;
-    ucs_queue_iter_t hash_iter, wild_iter, *iter;
-    uint64_t hash_sn, wild_sn, *sn_p;
-    ucp_request_t *req;
+    ucp_request_queue_t *match_queue = req_queue;
+    ucp_tag_exp_mask_index_t *index;
+    ucs_queue_iter_t iter, match_iter;
+    ucp_request_t *req, *match;
 
-    *hash_queue->ptail                 = NULL;
-    *tm->expected.wildcard.queue.ptail = NULL;
+    /* The requests which can match a tag are in posting order in each queue,
+     * so the first posted match is the one with the lowest sequence number
+     * among the first matches of the hash bucket, the wildcard queue, and
+     * the bucket of every mask index */
+    match = ucp_tag_exp_queue_find(&req_queue->queue, tag, &match_iter);
 
-    hash_iter = ucs_queue_iter_begin(hash_queue);
-    wild_iter = ucs_queue_iter_begin(&tm->expected.wildcard.queue);
+    req = ucp_tag_exp_queue_find(&tm->expected.wildcard.queue, tag, &iter);
+    if ((req != NULL) &&
+        ((match == NULL) || (req->recv.tag.sn < match->recv.tag.sn))) {
+        match       = req;
+        match_iter  = iter;
+        match_queue = &tm->expected.wildcard;
+    }
 
-    hash_sn = ucp_tag_exp_req_seq(hash_iter);
-    wild_sn = ucp_tag_exp_req_seq(wild_iter);
+    for (index = tm->expected.mask_index;
+         index < tm->expected.mask_index + UCP_TAG_MATCH_MASK_INDEX_MAX;
+         ++index) {
+        if (index->count == 0) {
+            continue;
+        }
 
-    while (hash_sn != wild_sn) {
-        if (hash_sn < wild_sn) {
-            iter  = &hash_iter;
-            sn_p  = &hash_sn;
-            queue = req_queue;
-        } else {
-            iter  = &wild_iter;
-            sn_p  = &wild_sn;
-            queue = &tm->expected.wildcard;
+        req = ucp_tag_exp_queue_find(ucp_tag_exp_mask_index_queue(index, tag),
+                                     tag, &iter);
+        if ((req != NULL) &&
+            ((match == NULL) || (req->recv.tag.sn < match->recv.tag.sn))) {
+            match       = req;
+            match_iter  = iter;
+            match_queue = &tm->expected.wildcard;
         }
+    }
 
-        req = ucs_container_of(**iter, ucp_request_t, recv.queue);
-        if (ucp_tag_is_match(tag, req->recv.tag.tag, req->recv.tag.tag_mask)) {
-            ucs_trace_req("matched received tag %"PRIx64" to req %p", tag, req);
-            ucp_tag_exp_delete(req, tm, queue, *iter);
-            return req;
+    if (match == NULL) {
+        return NULL;
+    }
+
+    ucs_trace_req("matched received tag %"PRIx64" to req %p", tag, match);
+    ucp_tag_exp_delete(match, tm, match_queue, match_iter);
+    return match;
+}
+
+/*
+ * Find the mask index of wildcard requests with the given mask. If 'create' is
+ * set and there is no such index, try to start indexing the mask.
+ */
+static ucp_tag_exp_mask_index_t *
+ucp_tag_exp_mask_index_get(ucp_tag_match_t *tm, ucp_tag_t tag_mask, int create)
+{
+    ucp_tag_exp_mask_index_t *index, *free_index = NULL;
+    size_t bucket;
+
+    for (index = tm->expected.mask_index;
+         index < tm->expected.mask_index + UCP_TAG_MATCH_MASK_INDEX_MAX;
+         ++index) {
+        if ((index->hash != NULL) && (index->tag_mask == tag_mask)) {
+            return index;
+        } else if ((free_index == NULL) && (index->count == 0)) {
+            free_index = index;
         }
+    }
 
-        *iter = ucs_queue_iter_next(*iter);
-        *sn_p = ucp_tag_exp_req_seq(*iter);
+    /* All requests with the same mask must be in the same queue, so a mask
+     * can be indexed only when the non-indexed wildcard queue is empty.
+     * An index of mask 0 would have a single bucket, so don't create it. */
+    if (!create || (free_index == NULL) || (tag_mask == 0) ||
+        !ucs_queue_is_empty(&tm->expected.wildcard.queue)) {
+        return NULL;
     }
 
-    ucs_assertv((hash_sn == ULONG_MAX) && (wild_sn == ULONG_MAX),
-                "hash_seq=%lu wild_seq=%lu", hash_sn, wild_sn);
-    ucs_assert(ucs_queue_iter_end(hash_queue, hash_iter));
-    ucs_assert(ucs_queue_iter_end(&tm->expected.wildcard.queue, wild_iter));
-    return NULL;
+    if (free_index->hash == NULL) {
+        free_index->hash = ucs_malloc(sizeof(*free_index->hash) *
+                                      UCS_BIT(UCP_TAG_MATCH_MASK_INDEX_ORDER),
+                                      "ucp_tm_exp_mask_index");
+        if (free_index->hash == NULL) {
+            return NULL;
+        }
+
+        for (bucket = 0; bucket < UCS_BIT(UCP_TAG_MATCH_MASK_INDEX_ORDER);
+             ++bucket) {
+            ucs_queue_head_init(&free_index->hash[bucket]);
+        }
+    }
+
+    ucs_trace("indexing expected wildcard requests with mask %"PRIx64,
+              tag_mask);
+    free_index->tag_mask = tag_mask;
+    return free_index;
+}
+
+void ucp_tag_exp_wild_push(ucp_tag_match_t *tm, ucp_request_t *req)
+{
+    ucp_tag_exp_mask_index_t *index;
+
+    ++tm->expected.wild_count;
+
+    index = ucp_tag_exp_mask_index_get(tm, req->recv.tag.tag_mask, 1);
+    if (index == NULL) {
+        ucs_queue_push(&tm->expected.wildcard.queue, &req->recv.queue);
+        return;
+    }
+
+    ++index->count;
+    ucs_queue_push(ucp_tag_exp_mask_index_queue(index, req->recv.tag.tag),
+                   &req->recv.queue);
+}
+
+ucs_queue_head_t *ucp_tag_exp_wild_queue(ucp_tag_match_t *tm,
+                                         ucp_request_t *req)
+{
+    ucp_tag_exp_mask_index_t *index;
+
+    index = ucp_tag_exp_mask_index_get(tm, req->recv.tag.tag_mask, 0);
+    if (index == NULL) {
+        return &tm->expected.wildcard.queue;
+    }
+
+    return ucp_tag_exp_mask_index_queue(index, req->recv.tag.tag);
+}
+
+void ucp_tag_exp_wild_remove(ucp_tag_match_t *tm, ucp_request_t *req,
+                             ucs_queue_iter_t iter)
+{
+    ucp_tag_exp_mask_index_t *index;
+
+    ucs_assert(tm->expected.wild_count > 0);
+    --tm->expected.wild_count;
+
+    index = ucp_tag_exp_mask_index_get(tm, req->recv.tag.tag_mask, 0);
+    if (index == NULL) {
+        ucs_queue_del_iter(&tm->expected.wildcard.queue, iter);
+        return;
+    }
+
+    ucs_assert(index->count > 0);
+    --index->count;
+    ucs_queue_del_iter(ucp_tag_exp_mask_index_queue(index, req->recv.tag.tag),
+                       iter);
+}
+
+int ucp_tag_unexp_mask_index_miss(ucp_tag_match_t *tm, ucp_tag_t tag_mask)
+{
+    ucs_list_link_t *hash = tm->unexpected.mask_index.hash;
+    ucp_recv_desc_t *rdesc;
+    size_t bucket;
+
+    if (tag_mask == 0) {
+        return 0;
+    }
+
+    /* Majority vote among the masks of searches which could not use the
+     * index, so that rare searches with another mask do not prevent indexing
+     * the frequent one */
+    if (tm->unexpected.mask_index.miss_count == 0) {
+        tm->unexpected.mask_index.miss_mask = tag_mask;
+    } else if (tm->unexpected.mask_index.miss_mask != tag_mask) {
+        --tm->unexpected.mask_index.miss_count;
+        return 0;
+    }
+
+    if (++tm->unexpected.mask_index.miss_count < UCP_TAG_MATCH_MASK_INDEX_VOTES) {
+        return 0;
+    }
+
+    if (hash == NULL) {
+        hash = ucs_malloc(sizeof(*hash) * UCS_BIT(UCP_TAG_MATCH_MASK_INDEX_ORDER),
+                          "ucp_tm_unexp_mask_index");
+        if (hash == NULL) {
+            return 0;
+        }
+    }
+
+    /* Rebuild the index for the new mask, adding the descriptors in arrival
+     * order */
+    for (bucket = 0; bucket < UCS_BIT(UCP_TAG_MATCH_MASK_INDEX_ORDER); ++bucket) {
+        ucs_list_head_init(&hash[bucket]);
+    }
+
+    ucs_trace("indexing unexpected tags with mask %"PRIx64, tag_mask);
+    tm->unexpected.mask_index.hash       = hash;
+    tm->unexpected.mask_index.tag_mask   = tag_mask;
+    tm->unexpected.mask_index.miss_count = 0;
+
+    ucs_list_for_each(rdesc, &tm->unexpected.all, tag_list[UCP_RDESC_ALL_LIST]) {
+        ucs_list_add_tail(ucp_tag_unexp_mask_index_list(tm,
+                                                        ucp_rdesc_get_tag(rdesc)),
+                          &rdesc->tag_list[UCP_RDESC_MASK_LIST]);
+    }
+
+    return 1;
 }
 
 void ucp_tag_frag_list_process_queue(ucp_tag_match_t *tm, ucp_request_t *req,
@@ -139,11 +560,11 @@ void ucp_tag_frag_list_process_queue(ucp_tag_match_t *tm, ucp_request_t *req,
     ucp_tag_frag_match_t *matchq;
     ucp_recv_desc_t *rdesc;
     ucs_status_t status;
-    khiter_t iter;
+    ucs_flat_hash_iter_t iter;
     int ret;
 
-    iter   = kh_put(ucp_tag_frag_hash, &tm->frag_hash, msg_id, &ret);
-    matchq = &kh_value(&tm->frag_hash, iter);
+    iter   = ucs_flat_hash_put(ucp_tag_frag_hash, &tm->frag_hash, msg_id, &ret);
+    matchq = &ucs_flat_hash_value(&tm->frag_hash, iter);
     if (ret == 0) {
         status = UCS_INPROGRESS;
         ucs_assert(ucp_tag_frag_match_is_unexp(matchq));
@@ -157,7 +578,7 @@ void ucp_tag_frag_list_process_queue(ucp_tag_match_t *tm, ucp_request_t *req,
 
         /* if we completed the request, delete hash entry */
         if (status != UCS_INPROGRESS) {
-            kh_del(ucp_tag_frag_hash, &tm->frag_hash, iter);
+            ucs_flat_hash_del(ucp_tag_frag_hash, &tm->frag_hash, iter);
         }
     }
 
@@ -10,16 +10,23 @@
 #include <ucp/api/ucp_def.h>
 #include <ucp/core/ucp_types.h>
 #include <ucs/datastruct/queue_types.h>
-#include <ucs/datastruct/khash.h>
+#include <ucs/datastruct/flat_hash.h>
 #include <ucs/sys/compiler_def.h>
 #include <ucs/stats/stats.h>
+#include <ucs/type/spinlock.h>
 
 
 #define UCP_TAG_MASK_FULL     0xffffffffffffffffUL  /* All 1-s */
 
+/* Maximal number of distinct masks of expected wildcard requests to index */
+#define UCP_TAG_MATCH_MASK_INDEX_MAX   4
 
-KHASH_INIT(ucp_tag_offload_hash, ucp_tag_t, ucp_worker_iface_t *, 1,
-           kh_int64_hash_func, kh_int64_hash_equal);
+/* Maximal number of tag bits which select a tag-matching partition */
+#define UCP_TAG_MATCH_CHANNEL_BITS_MAX 6
+
+
+UCS_FLAT_HASH_INIT(ucp_tag_offload_hash, ucp_tag_t, ucp_worker_iface_t *,
+                   ucs_flat_hash_int64_func, ucs_flat_hash_int64_equal);
 
 
 /**
@@ -42,6 +49,33 @@ typedef struct {
 } ucp_request_queue_t;
 
 
+/**
+ * State of a tag hash table which is resized incrementally. While a resize is
+ * in progress, the buckets of the old table are moved to the new one a few at
+ * a time; old buckets below 'rehash_idx' were already moved.
+ */
+typedef struct {
+    unsigned              shift;         /* 64 - log2(number of buckets) */
+    unsigned              old_shift;     /* Same, for the old table */
+    size_t                rehash_idx;    /* Next old bucket to move */
+    size_t                count;         /* Number of elements in the table */
+    size_t                grow_thresh;   /* Grow the table above this count */
+    size_t                shrink_thresh; /* Shrink the table below this count */
+} ucp_tag_hash_state_t;
+
+
+/**
+ * Index of expected wildcard requests with the same tag mask, for example all
+ * MPI_ANY_SOURCE receives. The requests are hashed by the tag bits under the
+ * mask, so all requests in a bucket which match a tag are in posting order.
+ */
+typedef struct {
+    ucp_tag_t             tag_mask;   /* Mask of the indexed requests */
+    size_t                count;      /* Number of indexed requests */
+    ucs_queue_head_t      *hash;      /* Hash table of the requests, or NULL */
+} ucp_tag_exp_mask_index_t;
+
+
 /**
  * Hash table entry for tag message fragments
  */
@@ -51,8 +85,8 @@ typedef union {
 } ucp_tag_frag_match_t;
 
 
-KHASH_INIT(ucp_tag_frag_hash, uint64_t, ucp_tag_frag_match_t, 1,
-           kh_int64_hash_func, kh_int64_hash_equal);
+UCS_FLAT_HASH_INIT(ucp_tag_frag_hash, uint64_t, ucp_tag_frag_match_t,
+                   ucs_flat_hash_int64_func, ucs_flat_hash_int64_equal);
 
 
 /**
@@ -60,10 +94,19 @@ KHASH_INIT(ucp_tag_frag_hash, uint64_t, ucp_tag_frag_match_t, 1,
  */
 typedef struct ucp_tag_match {
 
+    /* Protects the queues of a partition, see ucp_tag_match_get() */
+    ucs_spinlock_t            lock;
+
     /* Expected queue */
     struct {
-        ucp_request_queue_t   wildcard;   /* Expected wildcard requests */
+        ucp_request_queue_t   wildcard;   /* Expected wildcard requests which are
+                                             not indexed by mask. The counters
+                                             are of all wildcard requests. */
+        size_t                wild_count; /* Number of all wildcard requests */
+        ucp_tag_exp_mask_index_t mask_index[UCP_TAG_MATCH_MASK_INDEX_MAX];
         ucp_request_queue_t   *hash;      /* Hash table of expected non-wild tags */
+        ucp_request_queue_t   *old_hash;  /* Table being moved to 'hash', or NULL */
+        ucp_tag_hash_state_t  hash_state;
         uint64_t              sn;
         unsigned              sw_all_count; /* Number of all expected requests which
                                                are not posted to offload */
@@ -73,15 +116,30 @@ typedef struct ucp_tag_match {
     struct {
         ucs_list_link_t       all;        /* Linked list of all tags */
         ucs_list_link_t       *hash;      /* Hash table of unexpected tags */
+        ucs_list_link_t       *old_hash;  /* Table being moved to 'hash', or NULL */
+        ucp_tag_hash_state_t  hash_state;
+
+        /* Index of unexpected tags by the bits under the mask which is used
+         * most by wildcard searches */
+        struct {
+            ucp_tag_t         tag_mask;   /* Mask of the index */
+            ucs_list_link_t   *hash;      /* Hash table of all unexpected
+                                             descriptors, or NULL if the
+                                             index was not created yet */
+            ucp_tag_t         miss_mask;  /* Most frequent mask of searches
+                                             which could not use the index */
+            unsigned          miss_count; /* Vote count of 'miss_mask' */
+        } mask_index;
     } unexpected;
 
     /* Hash for fragment assembly, the key is a globally unique tag message id */
-    khash_t(ucp_tag_frag_hash) frag_hash;
+    ucs_flat_hash_t(ucp_tag_frag_hash) frag_hash;
 
     /* Tag offload fields */
     struct {
         ucs_queue_head_t      sync_reqs;        /* Outgoing sync send requests */
-        khash_t(ucp_tag_offload_hash) tag_hash; /* Hash table of offload ifaces */
+        ucs_flat_hash_t(ucp_tag_offload_hash) tag_hash; /* Hash table of offload
+                                                           ifaces */
         ucp_worker_iface_t    *iface;           /* Active offload iface (relevant if just
                                                    one iface is activated on the worker,
                                                    otherwise hash should be used) */
@@ -109,6 +167,20 @@ void ucp_tag_exp_remove(ucp_tag_match_t *tm, ucp_request_t *req);
 
 int ucp_tag_unexp_is_empty(ucp_tag_match_t *tm);
 
+void ucp_tag_exp_rehash(ucp_tag_match_t *tm);
+
+void ucp_tag_unexp_rehash(ucp_tag_match_t *tm);
+
+void ucp_tag_exp_wild_push(ucp_tag_match_t *tm, ucp_request_t *req);
+
+ucs_queue_head_t *ucp_tag_exp_wild_queue(ucp_tag_match_t *tm,
+                                         ucp_request_t *req);
+
+void ucp_tag_exp_wild_remove(ucp_tag_match_t *tm, ucp_request_t *req,
+                             ucs_queue_iter_t iter);
+
+int ucp_tag_unexp_mask_index_miss(ucp_tag_match_t *tm, ucp_tag_t tag_mask);
+
 ucp_request_t*
 ucp_tag_exp_search_all(ucp_tag_match_t *tm, ucp_request_queue_t *req_queue,
                        ucp_tag_t tag);
@@ -117,4 +189,16 @@ void ucp_tag_frag_list_process_queue(ucp_tag_match_t *tm, ucp_request_t *req,
                                      uint64_t msg_id
                                      UCS_STATS_ARG(int counter_idx));
 
+/**
+ * Post a receive on a request allocated by the caller, which can set up the
+ * user-defined part of the request beforehand. The callback may be called
+ * before this function returns. Must be called with the worker lock held.
+ * Returns an error if the tag mask does not select a single tag-matching
+ * partition, without posting the receive.
+ */
+ucs_status_t ucp_tag_recv_post(ucp_worker_h worker, ucp_request_t *req,
+                               void *buffer, size_t count, uintptr_t datatype,
+                               ucp_tag_t tag, ucp_tag_t tag_mask,
+                               ucp_tag_recv_callback_t cb);
+
 #endif
@@ -12,6 +12,7 @@
 
 #include <ucp/core/ucp_request.h>
 #include <ucp/core/ucp_request.inl>
+#include <ucp/core/ucp_worker.h>
 #include <ucp/dt/dt.h>
 #include <ucs/debug/log.h>
 #include <ucs/datastruct/queue.h>
@@ -19,9 +20,73 @@
 #include <inttypes.h>
 
 
-/* Hash size is a prime number just below 1024. Prime number for even distribution,
- * and small enough to fit L1 cache. */
-#define UCP_TAG_MATCH_HASH_SIZE     1021
+/* Golden ratio multiplier for Fibonacci hashing of tags */
+#define UCP_TAG_MATCH_HASH_MULT     0x9e3779b97f4a7c15ul
+
+/* Number of buckets in a mask index is 2^UCP_TAG_MATCH_MASK_INDEX_ORDER */
+#define UCP_TAG_MATCH_MASK_INDEX_ORDER 10
+
+
+#if ENABLE_MT
+
+#define UCP_TAG_MATCH_PART_LOCK(_worker, _tm)                           \
+    do {                                                                \
+        if (((_tm) != &(_worker)->tm) &&                                \
+            ((_worker)->flags & UCP_WORKER_FLAG_MT)) {                  \
+            ucs_spin_lock(&(_tm)->lock);                                \
+        }                                                               \
+    } while (0)
+
+
+#define UCP_TAG_MATCH_PART_UNLOCK(_worker, _tm)                         \
+    do {                                                                \
+        if (((_tm) != &(_worker)->tm) &&                                \
+            ((_worker)->flags & UCP_WORKER_FLAG_MT)) {                  \
+            ucs_spin_unlock(&(_tm)->lock);                              \
+        }                                                               \
+    } while (0)
+
+#else
+
+#define UCP_TAG_MATCH_PART_LOCK(_worker, _tm)
+#define UCP_TAG_MATCH_PART_UNLOCK(_worker, _tm)
+
+#endif
+
+
+/*
+ * Tag-matching queues of a tag. If matching is partitioned by the channel bits
+ * of the tag (UCX_TM_CHANNEL_BITS), receives are matched without the worker
+ * lock, and the queues of a partition are protected by UCP_TAG_MATCH_PART_LOCK.
+ * Otherwise, all tags are matched in worker->tm under the worker lock.
+ */
+static UCS_F_ALWAYS_INLINE ucp_tag_match_t*
+ucp_tag_match_get(ucp_worker_h worker, ucp_tag_t tag)
+{
+    if (ucs_likely(worker->tm_parts == NULL)) {
+        return &worker->tm;
+    }
+
+    return &worker->tm_parts[(tag & worker->tm_part_mask) >>
+                             worker->tm_part_shift];
+}
+
+/*
+ * A receive can be matched only if its tag mask includes all the channel bits,
+ * so that all matching messages are in the same partition.
+ */
+static UCS_F_ALWAYS_INLINE ucs_status_t
+ucp_tag_match_check_mask(ucp_worker_h worker, ucp_tag_t tag_mask)
+{
+    if (ucs_unlikely((tag_mask & worker->tm_part_mask) !=
+                     worker->tm_part_mask)) {
+        ucs_error("tag mask 0x%"PRIx64" does not include the tag matching "
+                  "channel bits 0x%"PRIx64, tag_mask, worker->tm_part_mask);
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    return UCS_OK;
+}
 
 
 static UCS_F_ALWAYS_INLINE
@@ -40,18 +105,56 @@ int ucp_tag_is_match(ucp_tag_t tag, ucp_tag_t exp_tag, ucp_tag_t tag_mask)
     return ((tag ^ exp_tag) & tag_mask) == 0;
 }
 
-static UCS_F_ALWAYS_INLINE size_t
+static UCS_F_ALWAYS_INLINE uint64_t
 ucp_tag_match_calc_hash(ucp_tag_t tag)
 {
-    /* Compute two 32-bit modulo and combine their result */
-    return ((uint32_t)tag % UCP_TAG_MATCH_HASH_SIZE) ^
-           ((uint32_t)(tag >> 32) % UCP_TAG_MATCH_HASH_SIZE);
+    /* Multiplicative hash: the bucket index is taken from the high bits of
+     * the product, which depend on all bits of the tag */
+    return tag * UCP_TAG_MATCH_HASH_MULT;
+}
+
+/*
+ * Return the bucket of a tag hash value. If the table is being resized and
+ * the bucket was not moved yet, return the bucket index in the old table and
+ * set 'in_old' to 1.
+ */
+static UCS_F_ALWAYS_INLINE size_t
+ucp_tag_hash_bucket(const ucp_tag_hash_state_t *state, const void *old_hash,
+                    uint64_t hash, int *in_old)
+{
+    size_t old_bucket;
+
+    if (ucs_unlikely(old_hash != NULL)) {
+        old_bucket = hash >> state->old_shift;
+        if (old_bucket >= state->rehash_idx) {
+            *in_old = 1;
+            return old_bucket;
+        }
+    }
+
+    *in_old = 0;
+    return hash >> state->shift;
+}
+
+static UCS_F_ALWAYS_INLINE int
+ucp_tag_hash_need_rehash(const ucp_tag_hash_state_t *state,
+                         const void *old_hash)
+{
+    return (old_hash != NULL) || (state->count > state->grow_thresh) ||
+           (state->count < state->shrink_thresh);
 }
 
 static UCS_F_ALWAYS_INLINE ucp_request_queue_t*
 ucp_tag_exp_get_queue_for_tag(ucp_tag_match_t *tm, ucp_tag_t tag)
 {
-    return &tm->expected.hash[ucp_tag_match_calc_hash(tag)];
+    size_t bucket;
+    int in_old;
+
+    bucket = ucp_tag_hash_bucket(&tm->expected.hash_state,
+                                 tm->expected.old_hash,
+                                 ucp_tag_match_calc_hash(tag), &in_old);
+    return in_old ? &tm->expected.old_hash[bucket] :
+                    &tm->expected.hash[bucket];
 }
 
 static UCS_F_ALWAYS_INLINE ucp_request_queue_t*
@@ -70,12 +173,48 @@ ucp_tag_exp_get_req_queue(ucp_tag_match_t *tm, ucp_request_t *req)
     return ucp_tag_exp_get_queue(tm, req->recv.tag.tag, req->recv.tag.tag_mask);
 }
 
+static UCS_F_ALWAYS_INLINE size_t
+ucp_tag_mask_index_bucket(ucp_tag_t tag, ucp_tag_t tag_mask)
+{
+    return ucp_tag_match_calc_hash(tag & tag_mask) >>
+           (64 - UCP_TAG_MATCH_MASK_INDEX_ORDER);
+}
+
+/*
+ * Queue which holds the request: a hash bucket for a specific tag, or the
+ * wildcard queue or a mask index bucket for a wildcard request.
+ */
+static UCS_F_ALWAYS_INLINE ucs_queue_head_t*
+ucp_tag_exp_req_list(ucp_tag_match_t *tm, ucp_request_queue_t *req_queue,
+                     ucp_request_t *req)
+{
+    if (ucs_likely(req_queue != &tm->expected.wildcard)) {
+        return &req_queue->queue;
+    }
+
+    return ucp_tag_exp_wild_queue(tm, req);
+}
+
 static UCS_F_ALWAYS_INLINE void
 ucp_tag_exp_push(ucp_tag_match_t *tm, ucp_request_queue_t *req_queue,
                  ucp_request_t *req)
 {
     req->recv.tag.sn = tm->expected.sn++;
+
+    if (ucs_unlikely(req_queue == &tm->expected.wildcard)) {
+        ucp_tag_exp_wild_push(tm, req);
+        return;
+    }
+
     ucs_queue_push(&req_queue->queue, &req->recv.queue);
+
+    /* Resize only after the request was added, since moving the buckets
+     * invalidates 'req_queue' */
+    ++tm->expected.hash_state.count;
+    if (ucs_unlikely(ucp_tag_hash_need_rehash(&tm->expected.hash_state,
+                                              tm->expected.old_hash))) {
+        ucp_tag_exp_rehash(tm);
+    }
 }
 
 static UCS_F_ALWAYS_INLINE void
@@ -84,6 +223,20 @@ ucp_tag_exp_add(ucp_tag_match_t *tm, ucp_request_t *req)
     ucp_tag_exp_push(tm, ucp_tag_exp_get_req_queue(tm, req), req);
 }
 
+static UCS_F_ALWAYS_INLINE void
+ucp_tag_exp_queue_remove(ucp_tag_match_t *tm, ucp_request_queue_t *req_queue,
+                         ucp_request_t *req, ucs_queue_iter_t iter)
+{
+    if (ucs_unlikely(req_queue == &tm->expected.wildcard)) {
+        ucp_tag_exp_wild_remove(tm, req, iter);
+        return;
+    }
+
+    ucs_assert(tm->expected.hash_state.count > 0);
+    --tm->expected.hash_state.count;
+    ucs_queue_del_iter(&req_queue->queue, iter);
+}
+
 static UCS_F_ALWAYS_INLINE void
 ucp_tag_exp_delete(ucp_request_t *req, ucp_tag_match_t *tm,
                    ucp_request_queue_t *req_queue, ucs_queue_iter_t iter)
@@ -95,7 +248,7 @@ ucp_tag_exp_delete(ucp_request_t *req, ucp_tag_match_t *tm,
             --req_queue->block_count;
         }
     }
-    ucs_queue_del_iter(&req_queue->queue, iter);
+    ucp_tag_exp_queue_remove(tm, req_queue, req, iter);
 }
 
 static UCS_F_ALWAYS_INLINE ucp_request_t *
@@ -105,7 +258,7 @@ ucp_tag_exp_search(ucp_tag_match_t *tm, ucp_tag_t tag)
     ucs_queue_iter_t iter;
     ucp_request_t *req;
 
-    if (ucs_unlikely(!ucs_queue_is_empty(&tm->expected.wildcard.queue))) {
+    if (ucs_unlikely(tm->expected.wild_count > 0)) {
         req_queue = ucp_tag_exp_get_queue_for_tag(tm, tag);
         return ucp_tag_exp_search_all(tm, req_queue, tag);
     }
@@ -133,14 +286,46 @@ static UCS_F_ALWAYS_INLINE ucp_tag_t ucp_rdesc_get_tag(ucp_recv_desc_t *rdesc)
 static UCS_F_ALWAYS_INLINE ucs_list_link_t*
 ucp_tag_unexp_get_list_for_tag(ucp_tag_match_t *tm, ucp_tag_t tag)
 {
-    return &tm->unexpected.hash[ucp_tag_match_calc_hash(tag)];
+    size_t bucket;
+    int in_old;
+
+    bucket = ucp_tag_hash_bucket(&tm->unexpected.hash_state,
+                                 tm->unexpected.old_hash,
+                                 ucp_tag_match_calc_hash(tag), &in_old);
+    return in_old ? &tm->unexpected.old_hash[bucket] :
+                    &tm->unexpected.hash[bucket];
+}
+
+static UCS_F_ALWAYS_INLINE ucs_list_link_t*
+ucp_tag_unexp_mask_index_list(ucp_tag_match_t *tm, ucp_tag_t tag)
+{
+    return &tm->unexpected.mask_index.hash[
+               ucp_tag_mask_index_bucket(tag, tm->unexpected.mask_index.tag_mask)];
+}
+
+/*
+ * The mask index can be used for a search if the search mask includes all bits
+ * of the index mask, since then all matching descriptors are in one bucket.
+ */
+static UCS_F_ALWAYS_INLINE int
+ucp_tag_unexp_mask_index_covers(ucp_tag_match_t *tm, ucp_tag_t tag_mask)
+{
+    ucp_tag_t index_mask = tm->unexpected.mask_index.tag_mask;
+
+    return (tm->unexpected.mask_index.hash != NULL) &&
+           ((tag_mask & index_mask) == index_mask);
 }
 
 static UCS_F_ALWAYS_INLINE void
-ucp_tag_unexp_remove(ucp_recv_desc_t *rdesc)
+ucp_tag_unexp_remove(ucp_tag_match_t *tm, ucp_recv_desc_t *rdesc)
 {
+    ucs_assert(tm->unexpected.hash_state.count > 0);
+    --tm->unexpected.hash_state.count;
     ucs_list_del(&rdesc->tag_list[UCP_RDESC_HASH_LIST]);
     ucs_list_del(&rdesc->tag_list[UCP_RDESC_ALL_LIST] );
+    if (ucs_unlikely(tm->unexpected.mask_index.hash != NULL)) {
+        ucs_list_del(&rdesc->tag_list[UCP_RDESC_MASK_LIST]);
+    }
 }
 
 static UCS_F_ALWAYS_INLINE void
@@ -151,9 +336,19 @@ ucp_tag_unexp_recv(ucp_tag_match_t *tm, ucp_recv_desc_t *rdesc, ucp_tag_t tag)
     hash_list = ucp_tag_unexp_get_list_for_tag(tm, tag);
     ucs_list_add_tail(hash_list,           &rdesc->tag_list[UCP_RDESC_HASH_LIST]);
     ucs_list_add_tail(&tm->unexpected.all, &rdesc->tag_list[UCP_RDESC_ALL_LIST]);
+    if (ucs_unlikely(tm->unexpected.mask_index.hash != NULL)) {
+        ucs_list_add_tail(ucp_tag_unexp_mask_index_list(tm, tag),
+                          &rdesc->tag_list[UCP_RDESC_MASK_LIST]);
+    }
 
     ucs_trace_req("unexp "UCP_RECV_DESC_FMT" tag %"PRIx64,
                   UCP_RECV_DESC_ARG(rdesc), tag);
+
+    ++tm->unexpected.hash_state.count;
+    if (ucs_unlikely(ucp_tag_hash_need_rehash(&tm->unexpected.hash_state,
+                                              tm->unexpected.old_hash))) {
+        ucp_tag_unexp_rehash(tm);
+    }
 }
 
 static UCS_F_ALWAYS_INLINE ucp_recv_desc_t*
@@ -185,6 +380,13 @@ ucp_tag_unexp_search(ucp_tag_match_t *tm, ucp_tag_t tag, uint64_t tag_mask,
             return NULL;
         }
         i_list = UCP_RDESC_HASH_LIST;
+    } else if (ucp_tag_unexp_mask_index_covers(tm, tag_mask) ||
+               ucp_tag_unexp_mask_index_miss(tm, tag_mask)) {
+        list = ucp_tag_unexp_mask_index_list(tm, tag);
+        if (ucs_list_is_empty(list)) {
+            return NULL;
+        }
+        i_list = UCP_RDESC_MASK_LIST;
     } else {
         list   = &tm->unexpected.all;
         i_list = UCP_RDESC_ALL_LIST;
@@ -201,7 +403,7 @@ ucp_tag_unexp_search(ucp_tag_match_t *tm, ucp_tag_t tag, uint64_t tag_mask,
                           "%s tag %"PRIx64"/%"PRIx64, UCP_RECV_DESC_ARG(rdesc),
                           title, tag, tag_mask);
             if (remove) {
-                ucp_tag_unexp_remove(rdesc);
+                ucp_tag_unexp_remove(tm, rdesc);
             }
             return rdesc;
         }
@@ -13,6 +13,7 @@
 #include <ucp/core/ucp_request.inl>
 #include <ucs/datastruct/mpool.inl>
 #include <ucs/datastruct/queue.h>
+#include <ucs/debug/memtrack.h>
 
 
 static UCS_F_ALWAYS_INLINE void
@@ -31,10 +32,11 @@ ucp_tag_recv_request_completed(ucp_request_t *req, ucs_status_t status,
 }
 
 static UCS_F_ALWAYS_INLINE void
-ucp_tag_recv_common(ucp_worker_h worker, void *buffer, size_t count,
-                    uintptr_t datatype, ucp_tag_t tag, ucp_tag_t tag_mask,
-                    ucp_request_t *req, uint32_t req_flags, ucp_tag_recv_callback_t cb,
-                    ucp_recv_desc_t *rdesc, const char *debug_name)
+ucp_tag_recv_common(ucp_worker_h worker, ucp_tag_match_t *tm, void *buffer,
+                    size_t count, uintptr_t datatype, ucp_tag_t tag,
+                    ucp_tag_t tag_mask, ucp_request_t *req, uint32_t req_flags,
+                    ucp_tag_recv_callback_t cb, ucp_recv_desc_t *rdesc,
+                    const char *debug_name)
 {
     unsigned common_flags = UCP_REQUEST_FLAG_RECV | UCP_REQUEST_FLAG_EXPECTED;
     ucp_eager_first_hdr_t *eagerf_hdr;
@@ -108,13 +110,13 @@ ucp_tag_recv_common(ucp_worker_h worker, void *buffer, size_t count,
     if (ucs_unlikely(rdesc == NULL)) {
         /* If not found on unexpected, wait until it arrives.
          * If was found but need this receive request for later completion, save it */
-        req_queue = ucp_tag_exp_get_queue(&worker->tm, tag, tag_mask);
+        req_queue = ucp_tag_exp_get_queue(tm, tag, tag_mask);
 
         /* If offload supported, post this tag to transport as well.
          * TODO: need to distinguish the cases when posting is not needed. */
-        ucp_tag_offload_try_post(worker, req, req_queue);
+        ucp_tag_offload_try_post(tm, req, req_queue);
 
-        ucp_tag_exp_push(&worker->tm, req_queue, req);
+        ucp_tag_exp_push(tm, req_queue, req);
 
         ucs_trace_req("%s returning expected request %p (%p)", debug_name, req,
                       req + 1);
@@ -151,6 +153,39 @@ ucp_tag_recv_common(ucp_worker_h worker, void *buffer, size_t count,
                                     UCS_STATS_ARG(UCP_WORKER_STAT_TAG_RX_EAGER_CHUNK_UNEXP));
 }
 
+/*
+ * Post a receive to a tag-matching partition, without the worker lock. The
+ * partition lock is held only for matching; a matched unexpected message is
+ * processed under the worker lock, which also protects the fragments of the
+ * messages in worker->tm.
+ */
+static void
+ucp_tag_recv_part(ucp_worker_h worker, void *buffer, size_t count,
+                  uintptr_t datatype, ucp_tag_t tag, ucp_tag_t tag_mask,
+                  ucp_request_t *req, uint32_t req_flags,
+                  ucp_tag_recv_callback_t cb, const char *debug_name)
+{
+    ucp_tag_match_t *tm = ucp_tag_match_get(worker, tag);
+    ucp_recv_desc_t *rdesc;
+
+    UCP_TAG_MATCH_PART_LOCK(worker, tm);
+
+    rdesc = ucp_tag_unexp_search(tm, tag, tag_mask, 1, debug_name);
+    if (rdesc == NULL) {
+        ucp_tag_recv_common(worker, tm, buffer, count, datatype, tag, tag_mask,
+                            req, req_flags, cb, NULL, debug_name);
+        UCP_TAG_MATCH_PART_UNLOCK(worker, tm);
+        return;
+    }
+
+    UCP_TAG_MATCH_PART_UNLOCK(worker, tm);
+
+    UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
+    ucp_tag_recv_common(worker, tm, buffer, count, datatype, tag, tag_mask, req,
+                        req_flags, cb, rdesc, debug_name);
+    UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(worker);
+}
+
 UCS_PROFILE_FUNC(ucs_status_t, ucp_tag_recv_nbr,
                  (worker, buffer, count, datatype, tag, tag_mask, request),
                  ucp_worker_h worker, void *buffer, size_t count,
@@ -159,15 +194,27 @@ UCS_PROFILE_FUNC(ucs_status_t, ucp_tag_recv_nbr,
 {
     ucp_request_t *req = (ucp_request_t *)request - 1;
     ucp_recv_desc_t *rdesc;
+    ucs_status_t status;
 
     UCP_CONTEXT_CHECK_FEATURE_FLAGS(worker->context, UCP_FEATURE_TAG,
                                     return UCS_ERR_INVALID_PARAM);
+
+    if (ucs_unlikely(worker->tm_parts != NULL)) {
+        status = ucp_tag_match_check_mask(worker, tag_mask);
+        if (status == UCS_OK) {
+            ucp_tag_recv_part(worker, buffer, count, datatype, tag, tag_mask,
+                              req, UCP_REQUEST_DEBUG_FLAG_EXTERNAL, NULL,
+                              "recv_nbr");
+        }
+        return status;
+    }
+
     UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
 
     rdesc = ucp_tag_unexp_search(&worker->tm, tag, tag_mask, 1, "recv_nbr");
-    ucp_tag_recv_common(worker, buffer, count, datatype, tag, tag_mask,
-                        req, UCP_REQUEST_DEBUG_FLAG_EXTERNAL, NULL, rdesc,
-                        "recv_nbr");
+    ucp_tag_recv_common(worker, &worker->tm, buffer, count, datatype, tag,
+                        tag_mask, req, UCP_REQUEST_DEBUG_FLAG_EXTERNAL, NULL,
+                        rdesc, "recv_nbr");
 
     UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(worker);
     return UCS_OK;
@@ -181,17 +228,38 @@ UCS_PROFILE_FUNC(ucs_status_ptr_t, ucp_tag_recv_nb,
 {
     ucp_recv_desc_t *rdesc;
     ucs_status_ptr_t ret;
+    ucs_status_t status;
     ucp_request_t *req;
 
     UCP_CONTEXT_CHECK_FEATURE_FLAGS(worker->context, UCP_FEATURE_TAG,
                                     return UCS_STATUS_PTR(UCS_ERR_INVALID_PARAM));
+
+    if (ucs_unlikely(worker->tm_parts != NULL)) {
+        status = ucp_tag_match_check_mask(worker, tag_mask);
+        if (status != UCS_OK) {
+            return UCS_STATUS_PTR(status);
+        }
+
+        UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
+        req = ucp_request_get(worker);
+        UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(worker);
+        if (req == NULL) {
+            return UCS_STATUS_PTR(UCS_ERR_NO_MEMORY);
+        }
+
+        ucp_tag_recv_part(worker, buffer, count, datatype, tag, tag_mask, req,
+                          UCP_REQUEST_FLAG_CALLBACK, cb, "recv_nb");
+        return req + 1;
+    }
+
     UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
 
     req = ucp_request_get(worker);
     if (ucs_likely(req != NULL)) {
         rdesc = ucp_tag_unexp_search(&worker->tm, tag, tag_mask, 1, "recv_nb");
-        ucp_tag_recv_common(worker, buffer, count, datatype, tag, tag_mask, req,
-                            UCP_REQUEST_FLAG_CALLBACK, cb, rdesc,"recv_nb");
+        ucp_tag_recv_common(worker, &worker->tm, buffer, count, datatype, tag,
+                            tag_mask, req, UCP_REQUEST_FLAG_CALLBACK, cb, rdesc,
+                            "recv_nb");
         ret = req + 1;
     } else {
         ret = UCS_STATUS_PTR(UCS_ERR_NO_MEMORY);
@@ -201,6 +269,174 @@ UCS_PROFILE_FUNC(ucs_status_ptr_t, ucp_tag_recv_nb,
     return ret;
 }
 
+/* Receives posted by ucp_tag_recv_batch_nb() */
+struct ucp_tag_recv_batch {
+    ucp_worker_h              worker;
+    size_t                    count;     /* Number of receives */
+    size_t                    completed; /* Receives before this index are
+                                            completed */
+    ucs_status_t              status;    /* Status of the first failed receive */
+    ucp_request_t             *reqs[0];
+};
+
+UCS_PROFILE_FUNC(ucs_status_t, ucp_tag_recv_batch_nb,
+                 (worker, elems, count, batch_p),
+                 ucp_worker_h worker, const ucp_tag_recv_batch_elem_t *elems,
+                 size_t count, ucp_tag_recv_batch_h *batch_p)
+{
+    const ucp_tag_recv_batch_elem_t *elem;
+    ucp_tag_recv_batch_h batch;
+    ucp_recv_desc_t *rdesc;
+    ucs_status_t status;
+    int unexp_empty;
+    size_t i;
+
+    UCP_CONTEXT_CHECK_FEATURE_FLAGS(worker->context, UCP_FEATURE_TAG,
+                                    return UCS_ERR_INVALID_PARAM);
+
+    if (ucs_unlikely(worker->tm_parts != NULL)) {
+        for (i = 0; i < count; ++i) {
+            status = ucp_tag_match_check_mask(worker, elems[i].tag_mask);
+            if (status != UCS_OK) {
+                return status;
+            }
+        }
+    }
+
+    batch = ucs_malloc(sizeof(*batch) + (sizeof(*batch->reqs) * count),
+                       "ucp_tag_recv_batch");
+    if (batch == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    batch->worker    = worker;
+    batch->count     = count;
+    batch->completed = 0;
+    batch->status    = UCS_OK;
+
+    UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
+
+    /* Allocate all requests before posting any receive, so that the batch is
+     * either posted completely or not at all */
+    for (i = 0; i < count; ++i) {
+        batch->reqs[i] = ucp_request_get(worker);
+        if (batch->reqs[i] == NULL) {
+            status = UCS_ERR_NO_MEMORY;
+            goto err_put_reqs;
+        }
+    }
+
+    if (ucs_unlikely(worker->tm_parts != NULL)) {
+        UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(worker);
+        for (i = 0, elem = elems; i < count; ++i, ++elem) {
+            ucp_tag_recv_part(worker, elem->buffer, elem->count, elem->datatype,
+                              elem->tag, elem->tag_mask, batch->reqs[i], 0,
+                              NULL, "recv_batch_nb");
+        }
+        goto out;
+    }
+
+    /* Posting receives can only remove descriptors from the unexpected queue,
+     * so it has to be checked again only after a receive matched it */
+    unexp_empty = ucp_tag_unexp_is_empty(&worker->tm);
+    for (i = 0, elem = elems; i < count; ++i, ++elem) {
+        if (unexp_empty) {
+            rdesc = NULL;
+        } else {
+            rdesc = ucp_tag_unexp_search(&worker->tm, elem->tag, elem->tag_mask,
+                                         1, "recv_batch_nb");
+            if (rdesc != NULL) {
+                unexp_empty = ucp_tag_unexp_is_empty(&worker->tm);
+            }
+        }
+
+        ucp_tag_recv_common(worker, &worker->tm, elem->buffer, elem->count,
+                            elem->datatype, elem->tag, elem->tag_mask,
+                            batch->reqs[i], 0, NULL, rdesc, "recv_batch_nb");
+    }
+
+    UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(worker);
+
+out:
+    *batch_p = batch;
+    return UCS_OK;
+
+err_put_reqs:
+    while (i-- > 0) {
+        ucp_request_put(batch->reqs[i]);
+    }
+    UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(worker);
+    ucs_free(batch);
+    return status;
+}
+
+ucs_status_t ucp_tag_recv_batch_test(ucp_tag_recv_batch_h batch,
+                                     ucp_tag_recv_info_t *info)
+{
+    ucp_request_t *req;
+
+    /* Receives usually complete in posting order, so continue from the first
+     * one which was not completed on the previous call */
+    while (batch->completed < batch->count) {
+        req = batch->reqs[batch->completed];
+        if (!(req->flags & UCP_REQUEST_FLAG_COMPLETED)) {
+            return UCS_INPROGRESS;
+        }
+
+        if (info != NULL) {
+            info[batch->completed] = req->recv.tag.info;
+        }
+
+        if ((req->status != UCS_OK) && (batch->status == UCS_OK)) {
+            batch->status = req->status;
+        }
+
+        ++batch->completed;
+    }
+
+    return batch->status;
+}
+
+void ucp_tag_recv_batch_free(ucp_tag_recv_batch_h batch)
+{
+    ucp_worker_h worker = batch->worker;
+    size_t i;
+
+    UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
+
+    for (i = 0; i < batch->count; ++i) {
+        ucp_request_cancel(worker, batch->reqs[i] + 1);
+        ucp_request_release(batch->reqs[i] + 1);
+    }
+
+    UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(worker);
+    ucs_free(batch);
+}
+
+ucs_status_t ucp_tag_recv_post(ucp_worker_h worker, ucp_request_t *req,
+                               void *buffer, size_t count, uintptr_t datatype,
+                               ucp_tag_t tag, ucp_tag_t tag_mask,
+                               ucp_tag_recv_callback_t cb)
+{
+    ucp_recv_desc_t *rdesc;
+    ucs_status_t status;
+
+    if (ucs_unlikely(worker->tm_parts != NULL)) {
+        status = ucp_tag_match_check_mask(worker, tag_mask);
+        if (status == UCS_OK) {
+            ucp_tag_recv_part(worker, buffer, count, datatype, tag, tag_mask,
+                              req, UCP_REQUEST_FLAG_CALLBACK, cb, "recv_post");
+        }
+        return status;
+    }
+
+    rdesc = ucp_tag_unexp_search(&worker->tm, tag, tag_mask, 1, "recv_post");
+    ucp_tag_recv_common(worker, &worker->tm, buffer, count, datatype, tag,
+                        tag_mask, req, UCP_REQUEST_FLAG_CALLBACK, cb, rdesc,
+                        "recv_post");
+    return UCS_OK;
+}
+
 UCS_PROFILE_FUNC(ucs_status_ptr_t, ucp_tag_msg_recv_nb,
                  (worker, buffer, count, datatype, message, cb),
                  ucp_worker_h worker, void *buffer, size_t count,
@@ -217,9 +453,11 @@ UCS_PROFILE_FUNC(ucs_status_ptr_t, ucp_tag_msg_recv_nb,
 
     req = ucp_request_get(worker);
     if (ucs_likely(req != NULL)) {
-        ucp_tag_recv_common(worker, buffer, count, datatype,
-                            ucp_rdesc_get_tag(rdesc), UCP_TAG_MASK_FULL, req,
-                            UCP_REQUEST_FLAG_CALLBACK, cb, rdesc, "msg_recv_nb");
+        ucp_tag_recv_common(worker,
+                            ucp_tag_match_get(worker, ucp_rdesc_get_tag(rdesc)),
+                            buffer, count, datatype, ucp_rdesc_get_tag(rdesc),
+                            UCP_TAG_MASK_FULL, req, UCP_REQUEST_FLAG_CALLBACK,
+                            cb, rdesc, "msg_recv_nb");
         ret = req + 1;
     } else {
         ret = UCS_STATUS_PTR(UCS_ERR_NO_MEMORY);
@@ -1113,7 +1113,9 @@ static ucs_status_t ucp_wireup_add_rma_bw_lanes(ucp_ep_h ep,
     if (ep_init_flags & UCP_EP_INIT_FLAG_MEM_TYPE) {
         bw_info.criteria.remote_md_flags = 0;
         bw_info.criteria.local_md_flags  = 0;
-    } else if (ucp_ep_get_context_features(ep) & UCP_FEATURE_TAG) {
+    } else if (ucp_ep_get_context_features(ep) & (UCP_FEATURE_TAG |
+                                                  UCP_FEATURE_STREAM |
+                                                  UCP_FEATURE_EXPERIMENTAL)) {
         /* if needed for RNDV, need only access for remote registered memory */
         bw_info.criteria.remote_md_flags = UCT_MD_FLAG_REG;
         bw_info.criteria.local_md_flags  = UCT_MD_FLAG_REG;
@@ -8,7 +8,7 @@
 
 #include <ucs/arch/atomic.h>
 #include <ucs/debug/debug.h>
-#include <ucs/datastruct/khash.h>
+#include <ucs/datastruct/flat_hash.h>
 #include <ucs/sys/sys.h>
 
 
@@ -19,11 +19,12 @@
 #define UCS_ASYNC_HANDLER_ARG(_h)   (_h), (_h)->id, ucs_debug_get_symbol_name((_h)->cb)
 
 /* Hash table for all event and timer handlers */
-KHASH_MAP_INIT_INT(ucs_async_handler, ucs_async_handler_t *);
+UCS_FLAT_HASH_INIT(ucs_async_handler, int, ucs_async_handler_t *,
+                   ucs_flat_hash_int64_func, ucs_flat_hash_int64_equal);
 
 
 typedef struct ucs_async_global_context {
-    khash_t(ucs_async_handler)     handlers;
+    ucs_flat_hash_t(ucs_async_handler) handlers;
     pthread_rwlock_t               handlers_lock;
     volatile uint32_t              handler_id;
 } ucs_async_global_context_t;
@@ -77,14 +78,15 @@ static ucs_async_ops_t ucs_async_poll_ops = {
     .remove_timer       = ucs_empty_function_return_success,
 };
 
-static inline khiter_t ucs_async_handler_kh_get(int id)
+static inline ucs_flat_hash_iter_t ucs_async_handler_hash_get(int id)
 {
-    return kh_get(ucs_async_handler, &ucs_async_global_context.handlers, id);
+    return ucs_flat_hash_get(ucs_async_handler,
+                             &ucs_async_global_context.handlers, id);
 }
 
-static inline int ucs_async_handler_kh_is_end(khiter_t hash_it)
+static inline int ucs_async_handler_hash_is_end(ucs_flat_hash_iter_t hash_it)
 {
-    return hash_it == kh_end(&ucs_async_global_context.handlers);
+    return hash_it == ucs_flat_hash_end(&ucs_async_global_context.handlers);
 }
 
 static void ucs_async_handler_hold(ucs_async_handler_t *handler)
@@ -96,16 +98,16 @@ static void ucs_async_handler_hold(ucs_async_handler_t *handler)
 static ucs_async_handler_t *ucs_async_handler_get(int id)
 {
     ucs_async_handler_t *handler;
-    khiter_t hash_it;
+    ucs_flat_hash_iter_t hash_it;
 
     pthread_rwlock_rdlock(&ucs_async_global_context.handlers_lock);
-    hash_it = ucs_async_handler_kh_get(id);
-    if (ucs_async_handler_kh_is_end(hash_it)) {
+    hash_it = ucs_async_handler_hash_get(id);
+    if (ucs_async_handler_hash_is_end(hash_it)) {
         handler = NULL;
         goto out_unlock;
     }
 
-    handler = kh_value(&ucs_async_global_context.handlers, hash_it);
+    handler = ucs_flat_hash_value(&ucs_async_global_context.handlers, hash_it);
     ucs_assert_always(handler->id == id);
     ucs_async_handler_hold(handler);
 
@@ -118,17 +120,18 @@ out_unlock:
 static ucs_async_handler_t *ucs_async_handler_extract(int id)
 {
     ucs_async_handler_t *handler;
-    khiter_t hash_it;
+    ucs_flat_hash_iter_t hash_it;
 
     pthread_rwlock_wrlock(&ucs_async_global_context.handlers_lock);
-    hash_it = ucs_async_handler_kh_get(id);
-    if (ucs_async_handler_kh_is_end(hash_it)) {
+    hash_it = ucs_async_handler_hash_get(id);
+    if (ucs_async_handler_hash_is_end(hash_it)) {
         ucs_debug("async handler [id=%d] not found in hash table", id);
         handler = NULL;
     } else {
-        handler = kh_value(&ucs_async_global_context.handlers, hash_it);
+        handler = ucs_flat_hash_value(&ucs_async_global_context.handlers, hash_it);
         ucs_assert_always(handler->id == id);
-        kh_del(ucs_async_handler, &ucs_async_global_context.handlers, hash_it);
+        ucs_flat_hash_del(ucs_async_handler, &ucs_async_global_context.handlers,
+                          hash_it);
         ucs_debug("removed async handler " UCS_ASYNC_HANDLER_FMT " from hash",
                   UCS_ASYNC_HANDLER_ARG(handler));
     }
@@ -155,7 +158,7 @@ static ucs_status_t ucs_async_handler_add(int min_id, int max_id,
 {
     int hash_extra_status;
     ucs_status_t status;
-    khiter_t hash_it;
+    ucs_flat_hash_iter_t hash_it;
     int i, id;
 
     pthread_rwlock_wrlock(&ucs_async_global_context.handlers_lock);
@@ -170,8 +173,9 @@ static ucs_status_t ucs_async_handler_add(int min_id, int max_id,
     for (i = min_id; i < max_id; ++i) {
         id = min_id + (ucs_atomic_fadd32(&ucs_async_global_context.handler_id, 1) %
                        (max_id - min_id));
-        hash_it = kh_put(ucs_async_handler, &ucs_async_global_context.handlers,
-                         id, &hash_extra_status);
+        hash_it = ucs_flat_hash_put(ucs_async_handler,
+                                    &ucs_async_global_context.handlers, id,
+                                    &hash_extra_status);
         if (hash_extra_status == -1) {
             ucs_error("Failed to add async handler " UCS_ASYNC_HANDLER_FMT
                       " to hash", UCS_ASYNC_HANDLER_ARG(handler));
@@ -191,8 +195,8 @@ static ucs_status_t ucs_async_handler_add(int min_id, int max_id,
         goto out_unlock;
     }
 
-    ucs_assert_always(!ucs_async_handler_kh_is_end(hash_it));
-    kh_value(&ucs_async_global_context.handlers, hash_it) = handler;
+    ucs_assert_always(!ucs_async_handler_hash_is_end(hash_it));
+    ucs_flat_hash_value(&ucs_async_global_context.handlers, hash_it) = handler;
     ucs_debug("added async handler " UCS_ASYNC_HANDLER_FMT " to hash",
               UCS_ASYNC_HANDLER_ARG(handler));
     status = UCS_OK;
@@ -340,7 +344,7 @@ void ucs_async_context_cleanup(ucs_async_context_t *async)
 
     if (async->num_handlers > 0) {
         pthread_rwlock_rdlock(&ucs_async_global_context.handlers_lock);
-        kh_foreach_value(&ucs_async_global_context.handlers, handler, {
+        ucs_flat_hash_foreach_value(&ucs_async_global_context.handlers, handler, {
             if (async == handler->async) {
                 ucs_warn("async %p handler "UCS_ASYNC_HANDLER_FMT" %s() not released",
                          async, UCS_ASYNC_HANDLER_ARG(handler),
@@ -594,9 +598,9 @@ void ucs_async_poll(ucs_async_context_t *async)
     ucs_trace_poll("async=%p", async);
 
     pthread_rwlock_rdlock(&ucs_async_global_context.handlers_lock);
-    handlers = ucs_alloca(kh_size(&ucs_async_global_context.handlers) * sizeof(*handlers));
+    handlers = ucs_alloca(ucs_flat_hash_size(&ucs_async_global_context.handlers) * sizeof(*handlers));
     n = 0;
-    kh_foreach_value(&ucs_async_global_context.handlers, handler, {
+    ucs_flat_hash_foreach_value(&ucs_async_global_context.handlers, handler, {
         if (((async == NULL) || (async == handler->async)) &&  /* Async context match */
             ((handler->async == NULL) || (handler->async->poll_block == 0)) && /* Not blocked */
             handler->events) /* Non-empty event set */
@@ -622,18 +626,18 @@ void ucs_async_global_init()
         ucs_fatal("pthread_rwlock_init() failed: %m");
     }
 
-    kh_init_inplace(ucs_async_handler, &ucs_async_global_context.handlers);
+    ucs_flat_hash_init(ucs_async_handler, &ucs_async_global_context.handlers);
     ucs_async_method_call_all(init);
 }
 
 void ucs_async_global_cleanup()
 {
-    int num_elems = kh_size(&ucs_async_global_context.handlers);
+    int num_elems = ucs_flat_hash_size(&ucs_async_global_context.handlers);
     if (num_elems != 0) {
         ucs_info("async handler table is not empty during exit (contains %d elems)",
                  num_elems);
     }
     ucs_async_method_call_all(cleanup);
-    kh_destroy_inplace(ucs_async_handler, &ucs_async_global_context.handlers);
+    ucs_flat_hash_destroy(ucs_async_handler, &ucs_async_global_context.handlers);
     pthread_rwlock_destroy(&ucs_async_global_context.handlers_lock);
 }
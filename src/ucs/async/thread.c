@@ -19,6 +19,7 @@
 
 #define UCS_ASYNC_EPOLL_MAX_EVENTS      16
 #define UCS_ASYNC_EPOLL_MIN_TIMEOUT_MS  2.0
+#define UCS_ASYNC_MAX_THREADS           64
 
 
 typedef struct ucs_async_thread {
@@ -31,17 +32,26 @@ typedef struct ucs_async_thread {
 } ucs_async_thread_t;
 
 
-typedef struct ucs_async_thread_global_context {
+typedef struct ucs_async_thread_slot {
     ucs_async_thread_t *thread;
     unsigned           use_count;
-    pthread_mutex_t    lock;
+} ucs_async_thread_slot_t;
+
+
+typedef struct ucs_async_thread_global_context {
+    ucs_async_thread_slot_t slots[UCS_ASYNC_MAX_THREADS];
+    unsigned                num_threads;  /* Pool size, fixed while in use */
+    unsigned                use_count;    /* Total use count of all slots */
+    volatile uint32_t       next_shard;   /* Round-robin shard assignment */
+    pthread_mutex_t         lock;
 } ucs_async_thread_global_context_t;
 
 
 static ucs_async_thread_global_context_t ucs_async_thread_global_context = {
-    .thread    = NULL,
-    .use_count = 0,
-    .lock      = PTHREAD_MUTEX_INITIALIZER
+    .num_threads = 0,
+    .use_count   = 0,
+    .next_shard  = 0,
+    .lock        = PTHREAD_MUTEX_INITIALIZER
 };
 
 
@@ -133,24 +143,82 @@ static void *ucs_async_thread_func(void *arg)
     return NULL;
 }
 
-static ucs_status_t ucs_async_thread_start(ucs_async_thread_t **thread_p)
+static unsigned ucs_async_thread_slot_index(ucs_async_context_t *async)
 {
-    ucs_async_thread_t *thread;
-    struct epoll_event event;
-    ucs_status_t status;
-    int wakeup_rfd;
+    /* Events which are not bound to a context are handled by the first thread */
+    return (async == NULL) ? 0 :
+           (async->thread.shard % ucs_async_thread_global_context.num_threads);
+}
+
+static ucs_async_thread_t *ucs_async_thread_get(ucs_async_context_t *async)
+{
+    unsigned index = ucs_async_thread_slot_index(async);
+    return ucs_async_thread_global_context.slots[index].thread;
+}
+
+static void ucs_async_thread_set_affinity(pthread_attr_t *attr, unsigned index)
+{
+    unsigned num_threads = ucs_async_thread_global_context.num_threads;
+    ucs_range_spec_t *range;
+    unsigned i, cpu, num_cpus;
+    cpu_set_t cpu_mask, process_mask;
     int ret;
 
-    ucs_trace_func("");
+    if (ucs_global_opts.async_thread_cpus.count == 0) {
+        return;
+    }
 
-    pthread_mutex_lock(&ucs_async_thread_global_context.lock);
-    if (ucs_async_thread_global_context.use_count++ > 0) {
-        /* Thread already started */
-        status = UCS_OK;
-        goto out_unlock;
+    /* Distribute the CPUs among the threads in round-robin order, or bind
+     * all threads to all CPUs if there are not enough of them */
+    CPU_ZERO(&cpu_mask);
+    num_cpus = 0;
+    for (i = 0; i < ucs_global_opts.async_thread_cpus.count; ++i) {
+        range = &ucs_global_opts.async_thread_cpus.ranges[i];
+        for (cpu = range->first; (cpu <= range->last) && (cpu < CPU_SETSIZE);
+             ++cpu, ++num_cpus) {
+            if ((num_cpus % num_threads) == index) {
+                CPU_SET(cpu, &cpu_mask);
+            }
+        }
+    }
+    if (num_cpus < num_threads) {
+        for (i = 0; i < ucs_global_opts.async_thread_cpus.count; ++i) {
+            range = &ucs_global_opts.async_thread_cpus.ranges[i];
+            for (cpu = range->first; (cpu <= range->last) && (cpu < CPU_SETSIZE);
+                 ++cpu) {
+                CPU_SET(cpu, &cpu_mask);
+            }
+        }
     }
 
-    ucs_assert_always(ucs_async_thread_global_context.thread == NULL);
+    /* Do not bind to CPUs outside of the process affinity (e.g cgroup or
+     * taskset restrictions), since thread creation would fail with EINVAL */
+    if (sched_getaffinity(0, sizeof(process_mask), &process_mask) == 0) {
+        CPU_AND(&cpu_mask, &cpu_mask, &process_mask);
+    }
+
+    if (CPU_COUNT(&cpu_mask) == 0) {
+        ucs_debug("async thread %u: none of the configured cpus are allowed, "
+                  "not setting affinity", index);
+        return;
+    }
+
+    ret = pthread_attr_setaffinity_np(attr, sizeof(cpu_mask), &cpu_mask);
+    if (ret != 0) {
+        ucs_warn("failed to set affinity of async thread %u: %s", index,
+                 strerror(ret));
+    }
+}
+
+static ucs_status_t ucs_async_thread_create(unsigned index,
+                                            ucs_async_thread_t **thread_p)
+{
+    ucs_async_thread_t *thread;
+    struct epoll_event event;
+    pthread_attr_t attr;
+    ucs_status_t status;
+    int wakeup_rfd;
+    int ret;
 
     thread = ucs_malloc(sizeof(*thread), "async_thread_context");
     if (thread == NULL) {
@@ -192,16 +260,21 @@ static ucs_status_t ucs_async_thread_start(ucs_async_thread_t **thread_p)
         goto err_close_epfd;
     }
 
-    ret = pthread_create(&thread->thread_id, NULL, ucs_async_thread_func, thread);
+    pthread_attr_init(&attr);
+    ucs_async_thread_set_affinity(&attr, index);
+    ret = pthread_create(&thread->thread_id, &attr, ucs_async_thread_func,
+                         thread);
+    pthread_attr_destroy(&attr);
     if (ret != 0) {
         ucs_error("pthread_create() returned %d: %m", ret);
         status = UCS_ERR_IO_ERROR;
         goto err_close_epfd;
     }
 
-    ucs_async_thread_global_context.thread = thread;
-    status = UCS_OK;
-    goto out_unlock;
+    ucs_debug("started async thread %u of %u", index,
+              ucs_async_thread_global_context.num_threads);
+    *thread_p = thread;
+    return UCS_OK;
 
 err_close_epfd:
     close(thread->epfd);
@@ -212,29 +285,63 @@ err_timerq_cleanup:
 err_free:
     ucs_free(thread);
 err:
-    --ucs_async_thread_global_context.use_count;
+    return status;
+}
+
+static ucs_status_t ucs_async_thread_start(ucs_async_context_t *async,
+                                           ucs_async_thread_t **thread_p)
+{
+    ucs_async_thread_global_context_t *ctx = &ucs_async_thread_global_context;
+    ucs_async_thread_slot_t *slot;
+    ucs_status_t status;
+
+    ucs_trace_func("async=%p", async);
+
+    pthread_mutex_lock(&ctx->lock);
+    if (ctx->use_count == 0) {
+        /* The pool size can be changed only while no thread is running */
+        ctx->num_threads = ucs_min(ucs_max(ucs_global_opts.async_num_threads, 1),
+                                   UCS_ASYNC_MAX_THREADS);
+    }
+
+    slot = &ctx->slots[ucs_async_thread_slot_index(async)];
+    if (slot->use_count == 0) {
+        ucs_assert_always(slot->thread == NULL);
+        status = ucs_async_thread_create(slot - ctx->slots, &slot->thread);
+        if (status != UCS_OK) {
+            goto out_unlock;
+        }
+    }
+
+    ++slot->use_count;
+    ++ctx->use_count;
+    *thread_p = slot->thread;
+    status    = UCS_OK;
+
 out_unlock:
-    ucs_assert_always(ucs_async_thread_global_context.thread != NULL);
-    *thread_p = ucs_async_thread_global_context.thread;
-    pthread_mutex_unlock(&ucs_async_thread_global_context.lock);
+    pthread_mutex_unlock(&ctx->lock);
     return status;
 }
 
-static void ucs_async_thread_stop()
+static void ucs_async_thread_stop(ucs_async_context_t *async)
 {
+    ucs_async_thread_global_context_t *ctx = &ucs_async_thread_global_context;
     ucs_async_thread_t *thread = NULL;
+    ucs_async_thread_slot_t *slot;
 
-    ucs_trace_func("");
+    ucs_trace_func("async=%p", async);
 
-    pthread_mutex_lock(&ucs_async_thread_global_context.lock);
-    if (--ucs_async_thread_global_context.use_count == 0) {
-        thread = ucs_async_thread_global_context.thread;
+    pthread_mutex_lock(&ctx->lock);
+    slot = &ctx->slots[ucs_async_thread_slot_index(async)];
+    --ctx->use_count;
+    if (--slot->use_count == 0) {
+        thread = slot->thread;
         ucs_async_thread_hold(thread);
         thread->stop = 1;
         ucs_async_pipe_push(&thread->wakeup);
-        ucs_async_thread_global_context.thread = NULL;
+        slot->thread = NULL;
     }
-    pthread_mutex_unlock(&ucs_async_thread_global_context.lock);
+    pthread_mutex_unlock(&ctx->lock);
 
     if (thread != NULL) {
         if (pthread_self() == thread->thread_id) {
@@ -246,8 +353,15 @@ static void ucs_async_thread_stop()
     }
 }
 
+static void ucs_async_thread_context_assign(ucs_async_context_t *async)
+{
+    async->thread.shard = ucs_atomic_fadd32(
+                    &ucs_async_thread_global_context.next_shard, 1);
+}
+
 static ucs_status_t ucs_async_thread_spinlock_init(ucs_async_context_t *async)
 {
+    ucs_async_thread_context_assign(async);
     return ucs_spinlock_init(&async->thread.spinlock);
 }
 
@@ -271,6 +385,7 @@ static ucs_status_t ucs_async_thread_mutex_init(ucs_async_context_t *async)
     pthread_mutexattr_t attr;
     int                 ret;
 
+    ucs_async_thread_context_assign(async);
     pthread_mutexattr_init(&attr);
     pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
     ret = pthread_mutex_init(&async->thread.mutex, &attr);
@@ -299,7 +414,7 @@ static ucs_status_t ucs_async_thread_add_event_fd(ucs_async_context_t *async,
     ucs_status_t status;
     int ret;
 
-    status = ucs_async_thread_start(&thread);
+    status = ucs_async_thread_start(async, &thread);
     if (status != UCS_OK) {
         goto err;
     }
@@ -319,7 +434,7 @@ static ucs_status_t ucs_async_thread_add_event_fd(ucs_async_context_t *async,
     return UCS_OK;
 
 err_removed:
-    ucs_async_thread_stop();
+    ucs_async_thread_stop(async);
 err:
     return status;
 }
@@ -327,7 +442,7 @@ err:
 static ucs_status_t ucs_async_thread_remove_event_fd(ucs_async_context_t *async,
                                                      int event_fd)
 {
-    ucs_async_thread_t *thread = ucs_async_thread_global_context.thread;
+    ucs_async_thread_t *thread = ucs_async_thread_get(async);
     int ret;
 
     ret = epoll_ctl(thread->epfd, EPOLL_CTL_DEL, event_fd, NULL);
@@ -337,14 +452,14 @@ static ucs_status_t ucs_async_thread_remove_event_fd(ucs_async_context_t *async,
         return UCS_ERR_INVALID_PARAM;
     }
 
-    ucs_async_thread_stop();
+    ucs_async_thread_stop(async);
     return UCS_OK;
 }
 
 static ucs_status_t ucs_async_thread_modify_event_fd(ucs_async_context_t *async,
                                                      int event_fd, int events)
 {
-    ucs_async_thread_t *thread = ucs_async_thread_global_context.thread;
+    ucs_async_thread_t *thread = ucs_async_thread_get(async);
     struct epoll_event event;
     int ret;
 
@@ -383,7 +498,7 @@ static ucs_status_t ucs_async_thread_add_timer(ucs_async_context_t *async,
         goto err;
     }
 
-    status = ucs_async_thread_start(&thread);
+    status = ucs_async_thread_start(async, &thread);
     if (status != UCS_OK) {
         goto err;
     }
@@ -397,7 +512,7 @@ static ucs_status_t ucs_async_thread_add_timer(ucs_async_context_t *async,
     return UCS_OK;
 
 err_stop:
-    ucs_async_thread_stop();
+    ucs_async_thread_stop(async);
 err:
     return status;
 }
@@ -405,17 +520,17 @@ err:
 static ucs_status_t ucs_async_thread_remove_timer(ucs_async_context_t *async,
                                                   int timer_id)
 {
-    ucs_async_thread_t *thread = ucs_async_thread_global_context.thread;
+    ucs_async_thread_t *thread = ucs_async_thread_get(async);
     ucs_timerq_remove(&thread->timerq, timer_id);
     ucs_async_pipe_push(&thread->wakeup);
-    ucs_async_thread_stop();
+    ucs_async_thread_stop(async);
     return UCS_OK;
 }
 
 static void ucs_async_signal_global_cleanup()
 {
-    if (ucs_async_thread_global_context.thread != NULL) {
-        ucs_info("async thread still running (use count %d)",
+    if (ucs_async_thread_global_context.use_count > 0) {
+        ucs_info("async threads still running (use count %d)",
                  ucs_async_thread_global_context.use_count);
     }
 }
@@ -16,6 +16,8 @@ typedef struct ucs_async_thread_context {
         ucs_spinlock_t      spinlock;
         pthread_mutex_t     mutex;
     };
+    unsigned                shard;   /* Selects the progress thread which
+                                        dispatches this context's events */
 } ucs_async_thread_context_t;
 
 #endif
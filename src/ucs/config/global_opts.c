@@ -30,6 +30,10 @@ ucs_global_opts_t ucs_global_opts = {
     .log_level_trigger     = UCS_LOG_LEVEL_FATAL,
     .warn_unused_env_vars  = 1,
     .async_max_events      = 64,
+    .async_num_threads     = 1,
+    .async_thread_cpus     = { NULL, 0 },
+    .progress_backoff_max  = 1,
+    .progress_backoff_thresh = 16,
     .async_signo           = SIGALRM,
     .stats_dest            = "",
     .tuning_path           = "",
@@ -56,6 +60,10 @@ static UCS_CONFIG_DEFINE_ARRAY(signo,
                                sizeof(int),
                                UCS_CONFIG_TYPE_SIGNO);
 
+static UCS_CONFIG_DEFINE_ARRAY(cpu_ranges,
+                               sizeof(ucs_range_spec_t),
+                               UCS_CONFIG_TYPE_RANGE_SPEC);
+
 static ucs_config_field_t ucs_global_opts_table[] = {
  {"LOG_LEVEL", "warn",
   "UCS logging level. Messages with a level higher or equal to the selected "
@@ -134,6 +142,35 @@ static ucs_config_field_t ucs_global_opts_table[] = {
   "Maximal number of events which can be handled from one context",
   ucs_offsetof(ucs_global_opts_t, async_max_events), UCS_CONFIG_TYPE_UINT},
 
+ {"ASYNC_THREADS", "1",
+  "Number of progress threads which handle events of thread-mode async\n"
+  "contexts. Each async context is assigned to one of the threads, so events\n"
+  "of different contexts (for example, different workers) can be dispatched\n"
+  "in parallel.",
+  ucs_offsetof(ucs_global_opts_t, async_num_threads), UCS_CONFIG_TYPE_UINT},
+
+ {"ASYNC_THREAD_AFFINITY", "",
+  "Comma-separated list of CPUs or CPU ranges (e.g 0-3,8) to bind async progress\n"
+  "threads to. The CPUs are distributed among the threads in round-robin order;\n"
+  "if there are less CPUs than threads, every thread is bound to all of them.\n"
+  "If empty, the threads inherit the affinity of the process.",
+  ucs_offsetof(ucs_global_opts_t, async_thread_cpus),
+  UCS_CONFIG_TYPE_ARRAY(cpu_ranges)},
+
+ {"PROGRESS_BACKOFF", "1",
+  "Maximal interval, in progress iterations, between calls to a fast-path\n"
+  "progress callback (for example, of a transport interface) which found no\n"
+  "work. The interval is doubled every PROGRESS_BACKOFF_THRESH idle calls, and\n"
+  "reset once the callback finds work again. Rounded up to a power of 2.\n"
+  "Larger values reduce the overhead of polling idle resources, at the cost\n"
+  "of higher latency when they become active. 1 disables the back-off.",
+  ucs_offsetof(ucs_global_opts_t, progress_backoff_max), UCS_CONFIG_TYPE_UINT},
+
+ {"PROGRESS_BACKOFF_THRESH", "16",
+  "Number of consecutive idle calls to a progress callback before the interval\n"
+  "between its calls is doubled. Used only if PROGRESS_BACKOFF is larger than 1.",
+  ucs_offsetof(ucs_global_opts_t, progress_backoff_thresh), UCS_CONFIG_TYPE_UINT},
+
  {"ASYNC_SIGNO", "SIGALRM",
   "Signal number used for async signaling.",
   ucs_offsetof(ucs_global_opts_t, async_signo), UCS_CONFIG_TYPE_SIGNO},
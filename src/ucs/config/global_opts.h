@@ -9,6 +9,7 @@
 
 #include "types.h"
 
+#include <ucs/config/parser.h>
 #include <ucs/stats/stats_fwd.h>
 #include <ucs/type/status.h>
 #include <ucs/sys/compiler_def.h>
@@ -72,6 +73,21 @@ typedef struct {
     /* Max. events per context, will be removed in the future */
     unsigned                 async_max_events;
 
+    /* Number of progress threads used by thread-mode async contexts */
+    unsigned                 async_num_threads;
+
+    /* CPUs to bind async progress threads to, empty means no binding */
+    UCS_CONFIG_ARRAY_FIELD(ucs_range_spec_t, ranges) async_thread_cpus;
+
+    /* Maximal interval, in progress iterations, between polls of an idle
+     * fast-path progress callback. 1 means every callback is polled on every
+     * iteration. */
+    unsigned                 progress_backoff_max;
+
+    /* Number of consecutive idle polls before a progress callback is polled
+     * less frequently */
+    unsigned                 progress_backoff_thresh;
+
     /* Destination for statistics: udp:host:port / file:path / stdout
      */
     char                     *stats_dest;
@@ -9,9 +9,13 @@
 #include <ucs/arch/atomic.h>
 #include <ucs/arch/bitops.h>
 #include <ucs/async/async.h>
+#include <ucs/config/global_opts.h>
 #include <ucs/debug/assert.h>
 #include <ucs/debug/debug.h>
+#include <ucs/stats/stats.h>
+#include <ucs/sys/math.h>
 #include <ucs/sys/sys.h>
+#include <ucs/time/time.h>
 
 #include "callbackq.h"
 
@@ -19,6 +23,29 @@
 #define UCS_CALLBACKQ_IDX_FLAG_SLOW  0x80000000u
 #define UCS_CALLBACKQ_IDX_MASK       0x7fffffffu
 #define UCS_CALLBACKQ_FAST_MAX       (UCS_CALLBACKQ_FAST_COUNT - 1)
+#define UCS_CALLBACKQ_MAX_POLL_MASK  (UCS_BIT(15) - 1)
+
+
+#if ENABLE_STATS
+enum {
+    UCS_CALLBACKQ_STAT_CALLS,
+    UCS_CALLBACKQ_STAT_EVENTS,
+    UCS_CALLBACKQ_STAT_CYCLES,
+    UCS_CALLBACKQ_STAT_BACKOFFS,
+    UCS_CALLBACKQ_STAT_LAST
+};
+
+static ucs_stats_class_t ucs_callbackq_stats_class = {
+    .name           = "callback",
+    .num_counters   = UCS_CALLBACKQ_STAT_LAST,
+    .counter_names  = {
+        [UCS_CALLBACKQ_STAT_CALLS]    = "calls",
+        [UCS_CALLBACKQ_STAT_EVENTS]   = "events",
+        [UCS_CALLBACKQ_STAT_CYCLES]   = "cycles",
+        [UCS_CALLBACKQ_STAT_BACKOFFS] = "backoffs"
+    }
+};
+#endif
 
 
 typedef struct ucs_callbackq_priv {
@@ -43,6 +70,10 @@ typedef struct ucs_callbackq_priv {
     int                    num_idxs;       /**< Size of idxs array */
     unsigned               *idxs;          /**< ID-to-index lookup */
 
+    uint32_t               dispatch_iter;  /**< Counts adaptive dispatches */
+    uint16_t               max_poll_mask;  /**< Maximal poll_mask of an element */
+    uint16_t               idle_thresh;    /**< Number of idle calls before an
+                                                element is backed off */
 } ucs_callbackq_priv_t;
 
 
@@ -64,6 +95,12 @@ static void ucs_callbackq_leave(ucs_callbackq_t *cbq)
     ucs_spin_unlock(&ucs_callbackq_priv(cbq)->lock);
 }
 
+static void ucs_callbackq_elem_set_active(ucs_callbackq_elem_t *elem)
+{
+    elem->idle_count = 0;
+    elem->poll_mask  = 0;
+}
+
 static void ucs_callbackq_elem_reset(ucs_callbackq_t *cbq,
                                      ucs_callbackq_elem_t *elem)
 {
@@ -71,6 +108,8 @@ static void ucs_callbackq_elem_reset(ucs_callbackq_t *cbq,
     elem->arg   = cbq;
     elem->id    = UCS_CALLBACKQ_ID_NULL;
     elem->flags = 0;
+    elem->stats = NULL;
+    ucs_callbackq_elem_set_active(elem);
 }
 
 static void *ucs_callbackq_array_grow(ucs_callbackq_t *cbq, void *ptr,
@@ -97,6 +136,37 @@ static void ucs_callbackq_array_free(void *ptr, size_t elem_size, int count)
     ucs_sys_free(ptr, elem_size * count);
 }
 
+/*
+ * Fast-path elements are added, moved and removed only by the dispatching
+ * thread, so their statistics can be updated during dispatch without a lock.
+ */
+static void ucs_callbackq_elem_stats_alloc(ucs_callbackq_t *cbq,
+                                           ucs_callbackq_elem_t *elem)
+{
+#if ENABLE_STATS
+    ucs_status_t status;
+
+    if (!(cbq->dispatch_flags & UCS_CALLBACKQ_DISPATCH_STATS)) {
+        return;
+    }
+
+    status = UCS_STATS_NODE_ALLOC(&elem->stats, &ucs_callbackq_stats_class,
+                                  ucs_stats_get_root(), "-%s",
+                                  ucs_debug_get_symbol_name(elem->cb));
+    if (status != UCS_OK) {
+        elem->stats = NULL;
+    }
+#endif
+}
+
+static void ucs_callbackq_elem_stats_free(ucs_callbackq_elem_t *elem)
+{
+#if ENABLE_STATS
+    UCS_STATS_NODE_FREE(elem->stats);
+    elem->stats = NULL;
+#endif
+}
+
 /*
  * @param [in]  id  ID to release in the lookup array.
  * @return index which this ID used to hold.
@@ -214,6 +284,8 @@ static int ucs_callbackq_add_fast(ucs_callbackq_t *cbq, ucs_callback_t cb,
     cbq->fast_elems[idx].arg   = arg;
     cbq->fast_elems[idx].flags = flags;
     cbq->fast_elems[idx].id    = id;
+    ucs_callbackq_elem_set_active(&cbq->fast_elems[idx]);
+    ucs_callbackq_elem_stats_alloc(cbq, &cbq->fast_elems[idx]);
     return id;
 }
 
@@ -226,6 +298,7 @@ static void ucs_callbackq_remove_fast(ucs_callbackq_t *cbq, unsigned idx)
     ucs_trace_func("cbq=%p idx=%u", cbq, idx);
 
     ucs_assert(priv->num_fast_elems > 0);
+    ucs_callbackq_elem_stats_free(&cbq->fast_elems[idx]);
     last_idx = --priv->num_fast_elems;
     ucs_callbackq_remove_common(cbq, cbq->fast_elems, idx, last_idx, 0,
                                 &priv->fast_remove_mask);
@@ -267,6 +340,7 @@ static void ucs_callbackq_enable_proxy(ucs_callbackq_t *cbq)
     cbq->fast_elems[idx].cb    = ucs_callbackq_slow_proxy;
     cbq->fast_elems[idx].flags = 0;
     cbq->fast_elems[idx].id    = id;
+    ucs_callbackq_elem_set_active(&cbq->fast_elems[idx]);
     /* Avoid writing 'arg' because the dispatching thread may not see it in case
      * of weak memory ordering. Instead, 'arg' is reset to 'cbq' for all free and
      * removed elements, from the main thread.
@@ -325,6 +399,7 @@ static int ucs_callbackq_add_slow(ucs_callbackq_t *cbq, ucs_callback_t cb,
     priv->slow_elems[idx].arg   = arg;
     priv->slow_elems[idx].flags = flags;
     priv->slow_elems[idx].id    = id;
+    ucs_callbackq_elem_set_active(&priv->slow_elems[idx]);
 
     ucs_callbackq_enable_proxy(cbq);
     return id;
@@ -380,6 +455,7 @@ static unsigned ucs_callbackq_slow_proxy(void *arg)
                 fast_idx = ucs_callbackq_get_fast_idx(cbq);
                 cbq->fast_elems[fast_idx] = *elem;
                 priv->idxs[elem->id]      = fast_idx;
+                ucs_callbackq_elem_stats_alloc(cbq, &cbq->fast_elems[fast_idx]);
                 ucs_callbackq_remove_slow(cbq, slow_idx);
             }
         } else if (elem->flags & UCS_CALLBACKQ_FLAG_ONESHOT) {
@@ -409,9 +485,71 @@ static unsigned ucs_callbackq_slow_proxy(void *arg)
     return count;
 }
 
+/* Call a fast-path element, and update its statistics */
+static UCS_F_ALWAYS_INLINE unsigned
+ucs_callbackq_elem_dispatch(ucs_callbackq_t *cbq, ucs_callbackq_elem_t *elem,
+                            ucs_callback_t cb)
+{
+#if ENABLE_STATS
+    ucs_time_t start_time;
+    unsigned count;
+
+    if (cbq->dispatch_flags & UCS_CALLBACKQ_DISPATCH_STATS) {
+        start_time = ucs_get_time();
+        count      = cb(elem->arg);
+        /* The callback may have removed itself and released its statistics,
+         * and another element could be moved to its place */
+        if (elem->cb == cb) {
+            UCS_STATS_UPDATE_COUNTER(elem->stats, UCS_CALLBACKQ_STAT_CYCLES,
+                                     ucs_get_time() - start_time);
+            UCS_STATS_UPDATE_COUNTER(elem->stats, UCS_CALLBACKQ_STAT_CALLS, 1);
+            UCS_STATS_UPDATE_COUNTER(elem->stats, UCS_CALLBACKQ_STAT_EVENTS,
+                                     count);
+        }
+        return count;
+    }
+#endif
+
+    return cb(elem->arg);
+}
+
+unsigned ucs_callbackq_dispatch_adaptive(ucs_callbackq_t *cbq)
+{
+    ucs_callbackq_priv_t *priv = ucs_callbackq_priv(cbq);
+    uint32_t iter              = ++priv->dispatch_iter;
+    ucs_callbackq_elem_t *elem;
+    ucs_callback_t cb;
+    unsigned count, elem_count;
+
+    count = 0;
+    for (elem = cbq->fast_elems; (cb = elem->cb) != NULL; ++elem) {
+        if (iter & elem->poll_mask) {
+            continue; /* Backed off */
+        }
+
+        elem_count = ucs_callbackq_elem_dispatch(cbq, elem, cb);
+        if (elem_count > 0) {
+            ucs_callbackq_elem_set_active(elem);
+            count += elem_count;
+        } else if ((cbq->dispatch_flags & UCS_CALLBACKQ_DISPATCH_ADAPTIVE) &&
+                   (++elem->idle_count >= priv->idle_thresh) &&
+                   /* slow-path proxy also completes lazy removals */
+                   (cb != ucs_callbackq_slow_proxy)) {
+            elem->idle_count = 0;
+            elem->poll_mask  = ucs_min((elem->poll_mask << 1) | 1,
+                                       priv->max_poll_mask);
+            UCS_STATS_UPDATE_COUNTER(elem->stats, UCS_CALLBACKQ_STAT_BACKOFFS,
+                                     1);
+        }
+    }
+
+    return count;
+}
+
 ucs_status_t ucs_callbackq_init(ucs_callbackq_t *cbq)
 {
     ucs_callbackq_priv_t *priv = ucs_callbackq_priv(cbq);
+    unsigned max_interval;
     unsigned idx;
 
     for (idx = 0; idx < UCS_CALLBACKQ_FAST_COUNT + 1; ++idx) {
@@ -429,12 +567,32 @@ ucs_status_t ucs_callbackq_init(ucs_callbackq_t *cbq)
     priv->free_idx_id       = UCS_CALLBACKQ_ID_NULL;
     priv->num_idxs          = 0;
     priv->idxs              = NULL;
+    priv->dispatch_iter     = 0;
+    cbq->dispatch_flags     = 0;
+
+    /* Adaptive dispatch, if maximal poll interval is larger than 1 */
+    max_interval            = ucs_min(ucs_global_opts.progress_backoff_max,
+                                      UCS_CALLBACKQ_MAX_POLL_MASK + 1);
+    priv->max_poll_mask     = ucs_roundup_pow2(ucs_max(max_interval, 1)) - 1;
+    priv->idle_thresh       = ucs_min(ucs_max(ucs_global_opts.progress_backoff_thresh,
+                                              1), UINT16_MAX);
+    if (priv->max_poll_mask > 0) {
+        cbq->dispatch_flags |= UCS_CALLBACKQ_DISPATCH_ADAPTIVE;
+    }
+
+#if ENABLE_STATS
+    if (ucs_stats_is_active()) {
+        cbq->dispatch_flags |= UCS_CALLBACKQ_DISPATCH_STATS;
+    }
+#endif
+
     return UCS_OK;
 }
 
 void ucs_callbackq_cleanup(ucs_callbackq_t *cbq)
 {
     ucs_callbackq_priv_t *priv = ucs_callbackq_priv(cbq);
+    unsigned idx;
 
     ucs_callbackq_disable_proxy(cbq);
 
@@ -446,6 +604,9 @@ void ucs_callbackq_cleanup(ucs_callbackq_t *cbq)
     ucs_callbackq_array_free(priv->slow_elems, sizeof(*priv->slow_elems),
                              priv->max_slow_elems);
     ucs_callbackq_array_free(priv->idxs, sizeof(*priv->idxs), priv->num_idxs);
+    for (idx = 0; idx < priv->num_fast_elems; ++idx) {
+        ucs_callbackq_elem_stats_free(&cbq->fast_elems[idx]);
+    }
 }
 
 int ucs_callbackq_add(ucs_callbackq_t *cbq, ucs_callback_t cb, void *arg,
@@ -9,6 +9,7 @@
 #define UCS_CALLBACKQ_H
 
 #include <ucs/datastruct/list_types.h>
+#include <ucs/stats/stats_fwd.h>
 #include <ucs/sys/compiler_def.h>
 #include <ucs/type/status.h>
 #include <stddef.h>
@@ -71,6 +72,18 @@ enum ucs_callbackq_flags {
 };
 
 
+/**
+ * @ingroup UCS_RESOURCE
+ * Dispatch modes of a callback queue, enabled by configuration.
+ */
+enum ucs_callbackq_dispatch_flags {
+    UCS_CALLBACKQ_DISPATCH_ADAPTIVE = UCS_BIT(0), /**< Poll idle fast-path
+                                                       callbacks less often */
+    UCS_CALLBACKQ_DISPATCH_STATS    = UCS_BIT(1)  /**< Count events and time
+                                                       of every callback */
+};
+
+
 /**
  * Callback queue element.
  */
@@ -79,6 +92,13 @@ struct ucs_callbackq_elem {
     void                           *arg;     /**< Function argument */
     unsigned                       flags;    /**< Callback flags */
     int                            id;       /**< Callback id */
+    uint16_t                       idle_count; /**< Number of consecutive calls
+                                                    which did no work */
+    uint16_t                       poll_mask;  /**< Adaptive dispatch calls the
+                                                    callback once in
+                                                    (poll_mask + 1) iterations */
+    ucs_stats_node_t               *stats;     /**< Dispatch statistics of a
+                                                    fast-path callback */
 };
 
 
@@ -92,11 +112,17 @@ struct ucs_callbackq {
      */
     ucs_callbackq_elem_t           fast_elems[UCS_CALLBACKQ_FAST_COUNT + 1];
 
+    /**
+     * Dispatch mode, from @ref ucs_callbackq_dispatch_flags. If zero, all
+     * fast-path callbacks are called on every dispatch.
+     */
+    unsigned                       dispatch_flags;
+
     /**
      * Private data, which we don't want to expose in API to avoid pulling
      * more header files
      */
-    char                           priv[72];
+    char                           priv[80];
 };
 
 
@@ -192,6 +218,22 @@ void ucs_callbackq_remove_if(ucs_callbackq_t *cbq, ucs_callbackq_predicate_t pre
                              void *arg);
 
 
+/**
+ * Dispatch callbacks from the callback queue in adaptive or profiling mode.
+ * Should not be called directly, @ref ucs_callbackq_dispatch calls it when
+ * @a cbq->dispatch_flags is nonzero.
+ *
+ * Fast-path callbacks which did no work for several consecutive calls are
+ * backed off: the interval between their calls is doubled, up to a configured
+ * maximum. A callback which did some work is called again on every dispatch.
+ *
+ * @param  [in] cbq      Callback queue to dispatch callbacks from.
+ *
+ * @return Sum of all return values from the dispatched callbacks.
+ */
+unsigned ucs_callbackq_dispatch_adaptive(ucs_callbackq_t *cbq);
+
+
 /**
  * Dispatch callbacks from the callback queue.
  * Must be called from single thread only.
@@ -206,6 +248,10 @@ static inline unsigned ucs_callbackq_dispatch(ucs_callbackq_t *cbq)
     ucs_callback_t cb;
     unsigned count;
 
+    if (ucs_unlikely(cbq->dispatch_flags)) {
+        return ucs_callbackq_dispatch_adaptive(cbq);
+    }
+
     count = 0;
     for (elem = cbq->fast_elems; (cb = elem->cb) != NULL; ++elem) {
         count += cb(elem->arg);
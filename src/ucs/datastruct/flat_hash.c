@@ -0,0 +1,18 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2019.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+#include "flat_hash.h"
+
+
+const int8_t ucs_flat_hash_empty_group[UCS_FLAT_HASH_GROUP_SIZE]
+    UCS_V_ALIGNED(UCS_FLAT_HASH_GROUP_SIZE) = {
+    UCS_FLAT_HASH_CTRL_EMPTY, UCS_FLAT_HASH_CTRL_EMPTY, UCS_FLAT_HASH_CTRL_EMPTY,
+    UCS_FLAT_HASH_CTRL_EMPTY, UCS_FLAT_HASH_CTRL_EMPTY, UCS_FLAT_HASH_CTRL_EMPTY,
+    UCS_FLAT_HASH_CTRL_EMPTY, UCS_FLAT_HASH_CTRL_EMPTY, UCS_FLAT_HASH_CTRL_EMPTY,
+    UCS_FLAT_HASH_CTRL_EMPTY, UCS_FLAT_HASH_CTRL_EMPTY, UCS_FLAT_HASH_CTRL_EMPTY,
+    UCS_FLAT_HASH_CTRL_EMPTY, UCS_FLAT_HASH_CTRL_EMPTY, UCS_FLAT_HASH_CTRL_EMPTY,
+    UCS_FLAT_HASH_CTRL_EMPTY
+};
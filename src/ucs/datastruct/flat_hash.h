@@ -0,0 +1,441 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2019.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+#ifndef UCS_FLAT_HASH_H_
+#define UCS_FLAT_HASH_H_
+
+#include <ucs/arch/bitops.h>
+#include <ucs/debug/memtrack.h>
+#include <ucs/sys/compiler_def.h>
+#include <ucs/sys/math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+BEGIN_C_DECLS
+
+/** @file flat_hash.h */
+
+/*
+ * Open-addressing hash table with inline keys and values.
+ *
+ * The result of the hash function is multiplied by the golden ratio
+ * (Fibonacci hashing), and its top bits select the "home" slot of the key, so
+ * sequential integer keys spread evenly without a mixing hash function. An
+ * element is stored in its home slot if it is free; a lookup checks the home
+ * slot first, loading its control byte and key in parallel.
+ *
+ * Otherwise, slots are divided into groups of UCS_FLAT_HASH_GROUP_SIZE. Every
+ * slot has a control byte, which holds 7 more bits of the hash if the slot is
+ * used, or marks it as empty or deleted. The lookup probes the control bytes
+ * of a whole group at once (using SSE2 if available), and compares keys only
+ * for slots whose hash bits match. Groups are probed in triangular sequence,
+ * starting from the group of the home slot, and the lookup stops at the first
+ * group which has an empty slot.
+ *
+ * The API follows khash.h:
+ *  - UCS_FLAT_HASH_TYPE(name, key_t, value_t) declares the hash type.
+ *  - UCS_FLAT_HASH_IMPL(name, scope, key_t, value_t, hash_func, equal_func)
+ *    defines the functions.
+ *  - UCS_FLAT_HASH_INIT(...) does both, with "static inline" scope.
+ *
+ * Like khash, inserting an element may move other elements, so pointers to
+ * values and iterators are invalidated by ucs_flat_hash_put(). Removing
+ * elements does not move other elements.
+ */
+
+
+#define UCS_FLAT_HASH_GROUP_SIZE   16
+#define UCS_FLAT_HASH_CTRL_EMPTY   ((int8_t)-128) /* 0x80 */
+#define UCS_FLAT_HASH_CTRL_DELETED ((int8_t)-2)   /* 0xfe */
+#define UCS_FLAT_HASH_GROUP_SHIFT  4              /* log2(group size) */
+#define UCS_FLAT_HASH_H2_BITS      7
+
+
+/* Control bytes of an empty hash table */
+extern const int8_t ucs_flat_hash_empty_group[UCS_FLAT_HASH_GROUP_SIZE];
+
+
+typedef size_t ucs_flat_hash_iter_t;
+
+
+/* 2^64 divided by the golden ratio */
+#define UCS_FLAT_HASH_MULTIPLIER   0x9e3779b97f4a7c15ul
+
+
+/**
+ * Hash function for integer keys. The table mixes the hash value, so the key
+ * itself is used.
+ */
+#define ucs_flat_hash_int64_func(_key) ((uint64_t)(_key))
+
+#define ucs_flat_hash_int64_equal(_a, _b) ((_a) == (_b))
+
+
+/**
+ * @return Control byte of a used slot: the hash bits which follow the bits
+ *         selecting the home slot.
+ */
+static UCS_F_ALWAYS_INLINE int8_t ucs_flat_hash_h2(uint64_t hash, unsigned shift)
+{
+    return (hash >> (shift - UCS_FLAT_HASH_H2_BITS)) &
+           UCS_MASK(UCS_FLAT_HASH_H2_BITS);
+}
+
+
+/**
+ * @return Bit mask of the slots in a group whose control byte is @a value.
+ */
+static UCS_F_ALWAYS_INLINE unsigned
+ucs_flat_hash_group_match(const int8_t *group, int8_t value)
+{
+#ifdef __SSE2__
+    __m128i ctrl = _mm_load_si128((const __m128i*)group);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(value)));
+#else
+    unsigned i, mask = 0;
+
+    for (i = 0; i < UCS_FLAT_HASH_GROUP_SIZE; ++i) {
+        mask |= (group[i] == value) << i;
+    }
+    return mask;
+#endif
+}
+
+/**
+ * @return Bit mask of the slots in a group which are empty or deleted.
+ */
+static UCS_F_ALWAYS_INLINE unsigned
+ucs_flat_hash_group_match_free(const int8_t *group)
+{
+#ifdef __SSE2__
+    /* Empty and deleted control bytes are the only negative ones */
+    return _mm_movemask_epi8(_mm_load_si128((const __m128i*)group));
+#else
+    unsigned i, mask = 0;
+
+    for (i = 0; i < UCS_FLAT_HASH_GROUP_SIZE; ++i) {
+        mask |= (group[i] < 0) << i;
+    }
+    return mask;
+#endif
+}
+
+
+#define ucs_flat_hash_t(_name) \
+    ucs_flat_hash_##_name##_t
+
+
+#define UCS_FLAT_HASH_TYPE(_name, _key_t, _val_t) \
+    typedef struct { \
+        _key_t                    key; \
+        _val_t                    value; \
+    } ucs_flat_hash_##_name##_slot_t; \
+    \
+    typedef struct { \
+        int8_t                    *ctrl;        /* Control bytes */ \
+        ucs_flat_hash_##_name##_slot_t *slots;  /* Keys and values */ \
+        size_t                    capacity;     /* Number of slots */ \
+        size_t                    group_mask;   /* Number of groups - 1 */ \
+        unsigned                  shift;        /* 64 - log2(capacity) */ \
+        size_t                    size;         /* Number of elements */ \
+        size_t                    growth_left;  /* Empty slots which may be \
+                                                   used before resize */ \
+    } ucs_flat_hash_t(_name);
+
+
+#define UCS_FLAT_HASH_IMPL(_name, _scope, _key_t, _val_t, _hash_func, \
+                           _equal_func) \
+    \
+    _scope void ucs_flat_hash_init_##_name(ucs_flat_hash_t(_name) *h) \
+    { \
+        h->ctrl        = (int8_t*)ucs_flat_hash_empty_group; \
+        h->slots       = NULL; \
+        h->capacity    = 0; \
+        h->group_mask  = 0; \
+        h->shift       = 64 - UCS_FLAT_HASH_GROUP_SHIFT; \
+        h->size        = 0; \
+        h->growth_left = 0; \
+    } \
+    \
+    _scope void ucs_flat_hash_destroy_##_name(ucs_flat_hash_t(_name) *h) \
+    { \
+        if (h->capacity > 0) { \
+            ucs_free(h->ctrl); \
+        } \
+        ucs_flat_hash_init_##_name(h); \
+    } \
+    \
+    /* Mixed hash value, the top bits select the home slot */ \
+    static UCS_F_ALWAYS_INLINE uint64_t \
+    ucs_flat_hash_mix_##_name(_key_t key) \
+    { \
+        return (uint64_t)(_hash_func(key)) * UCS_FLAT_HASH_MULTIPLIER; \
+    } \
+    \
+    /* Probe the groups, after the key was not found in its home slot */ \
+    _scope ucs_flat_hash_iter_t \
+    ucs_flat_hash_probe_##_name(const ucs_flat_hash_t(_name) *h, _key_t key, \
+                                uint64_t hash) \
+    { \
+        int8_t h2     = ucs_flat_hash_h2(hash, h->shift); \
+        size_t group  = (hash >> h->shift) / UCS_FLAT_HASH_GROUP_SIZE; \
+        size_t step   = 0; \
+        const int8_t *ctrl; \
+        unsigned match; \
+        size_t index; \
+        \
+        for (;;) { \
+            ctrl  = h->ctrl + (group * UCS_FLAT_HASH_GROUP_SIZE); \
+            match = ucs_flat_hash_group_match(ctrl, h2); \
+            while (match != 0) { \
+                index = (group * UCS_FLAT_HASH_GROUP_SIZE) + ucs_ffs64(match); \
+                if (_equal_func(h->slots[index].key, key)) { \
+                    return index; \
+                } \
+                match &= match - 1; \
+            } \
+            \
+            if (ucs_likely(ucs_flat_hash_group_match(ctrl, \
+                                                     UCS_FLAT_HASH_CTRL_EMPTY))) { \
+                return h->capacity; \
+            } \
+            \
+            group = (group + ++step) & h->group_mask; \
+        } \
+    } \
+    \
+    static UCS_F_ALWAYS_INLINE ucs_flat_hash_iter_t \
+    ucs_flat_hash_find_##_name(const ucs_flat_hash_t(_name) *h, _key_t key, \
+                               uint64_t hash) \
+    { \
+        size_t index = hash >> h->shift; \
+        \
+        if (ucs_likely((h->ctrl[index] == ucs_flat_hash_h2(hash, h->shift)) && \
+                       _equal_func(h->slots[index].key, key))) { \
+            return index; \
+        } \
+        \
+        return ucs_flat_hash_probe_##_name(h, key, hash); \
+    } \
+    \
+    /* Find the home slot of 'hash' if it is free, otherwise the first empty or \
+     * deleted slot in its probe sequence */ \
+    _scope size_t \
+    ucs_flat_hash_find_free_##_name(const ucs_flat_hash_t(_name) *h, \
+                                    uint64_t hash) \
+    { \
+        size_t index = hash >> h->shift; \
+        size_t group = index / UCS_FLAT_HASH_GROUP_SIZE; \
+        size_t step  = 0; \
+        unsigned match; \
+        \
+        if (h->ctrl[index] < 0) { \
+            return index; \
+        } \
+        \
+        for (;;) { \
+            match = ucs_flat_hash_group_match_free(h->ctrl + \
+                                                   (group * UCS_FLAT_HASH_GROUP_SIZE)); \
+            if (match != 0) { \
+                return (group * UCS_FLAT_HASH_GROUP_SIZE) + ucs_ffs64(match); \
+            } \
+            group = (group + ++step) & h->group_mask; \
+        } \
+    } \
+    \
+    _scope int ucs_flat_hash_resize_##_name(ucs_flat_hash_t(_name) *h, \
+                                            size_t capacity) \
+    { \
+        ucs_flat_hash_t(_name) new_h; \
+        size_t index, new_index; \
+        uint64_t hash; \
+        \
+        new_h.ctrl = (int8_t*)ucs_memalign(UCS_FLAT_HASH_GROUP_SIZE, \
+                                           capacity * (sizeof(*new_h.ctrl) + \
+                                                       sizeof(*new_h.slots)), \
+                                           "flat_hash"); \
+        if (new_h.ctrl == NULL) { \
+            return -1; \
+        } \
+        \
+        memset(new_h.ctrl, UCS_FLAT_HASH_CTRL_EMPTY, capacity); \
+        new_h.slots       = (ucs_flat_hash_##_name##_slot_t*) \
+                            (new_h.ctrl + capacity); \
+        new_h.capacity    = capacity; \
+        new_h.group_mask  = (capacity / UCS_FLAT_HASH_GROUP_SIZE) - 1; \
+        new_h.shift       = 64 - ucs_ilog2(capacity); \
+        new_h.size        = h->size; \
+        new_h.growth_left = (capacity - (capacity / 8)) - h->size; \
+        \
+        for (index = 0; index < h->capacity; ++index) { \
+            if (h->ctrl[index] >= 0) { \
+                hash      = ucs_flat_hash_mix_##_name(h->slots[index].key); \
+                new_index = ucs_flat_hash_find_free_##_name(&new_h, hash); \
+                new_h.ctrl[new_index]  = ucs_flat_hash_h2(hash, new_h.shift); \
+                new_h.slots[new_index] = h->slots[index]; \
+            } \
+        } \
+        \
+        if (h->capacity > 0) { \
+            ucs_free(h->ctrl); \
+        } \
+        *h = new_h; \
+        return 0; \
+    } \
+    \
+    static UCS_F_ALWAYS_INLINE ucs_flat_hash_iter_t \
+    ucs_flat_hash_get_##_name(const ucs_flat_hash_t(_name) *h, _key_t key) \
+    { \
+        return ucs_flat_hash_find_##_name(h, key, \
+                                          ucs_flat_hash_mix_##_name(key)); \
+    } \
+    \
+    /* ret_p is set to 1 if the key was added, 0 if it was already present, \
+     * or -1 if memory allocation failed */ \
+    _scope ucs_flat_hash_iter_t \
+    ucs_flat_hash_put_##_name(ucs_flat_hash_t(_name) *h, _key_t key, \
+                              int *ret_p) \
+    { \
+        uint64_t hash = ucs_flat_hash_mix_##_name(key); \
+        size_t index, capacity; \
+        \
+        index = ucs_flat_hash_find_##_name(h, key, hash); \
+        if (index != h->capacity) { \
+            *ret_p = 0; \
+            return index; \
+        } \
+        \
+        index = ucs_flat_hash_find_free_##_name(h, hash); \
+        if ((h->ctrl[index] == UCS_FLAT_HASH_CTRL_EMPTY) && \
+            (h->growth_left == 0)) { \
+            /* Rehash in-place if at least half of the used slots are \
+             * deleted, otherwise grow */ \
+            capacity = ucs_max(h->capacity, UCS_FLAT_HASH_GROUP_SIZE); \
+            if (h->size * 2 > (capacity - (capacity / 8))) { \
+                capacity *= 2; \
+            } \
+            \
+            if (ucs_flat_hash_resize_##_name(h, capacity) != 0) { \
+                *ret_p = -1; \
+                return h->capacity; \
+            } \
+            index = ucs_flat_hash_find_free_##_name(h, hash); \
+        } \
+        \
+        if (h->ctrl[index] == UCS_FLAT_HASH_CTRL_EMPTY) { \
+            --h->growth_left; \
+        } \
+        \
+        h->ctrl[index]      = ucs_flat_hash_h2(hash, h->shift); \
+        h->slots[index].key = key; \
+        ++h->size; \
+        *ret_p = 1; \
+        return index; \
+    } \
+    \
+    _scope void ucs_flat_hash_del_##_name(ucs_flat_hash_t(_name) *h, \
+                                          ucs_flat_hash_iter_t index) \
+    { \
+        const int8_t *group = h->ctrl + (index & \
+                                         ~(size_t)(UCS_FLAT_HASH_GROUP_SIZE - 1)); \
+        \
+        /* If the group has an empty slot, no lookup ever probed beyond it, \
+         * so the slot can become empty rather than deleted */ \
+        if (ucs_flat_hash_group_match(group, UCS_FLAT_HASH_CTRL_EMPTY)) { \
+            h->ctrl[index] = UCS_FLAT_HASH_CTRL_EMPTY; \
+            ++h->growth_left; \
+        } else { \
+            h->ctrl[index] = UCS_FLAT_HASH_CTRL_DELETED; \
+        } \
+        --h->size; \
+    }
+
+
+#define UCS_FLAT_HASH_INIT(_name, _key_t, _val_t, _hash_func, _equal_func) \
+    UCS_FLAT_HASH_TYPE(_name, _key_t, _val_t) \
+    UCS_FLAT_HASH_IMPL(_name, static UCS_F_MAYBE_UNUSED inline, _key_t, \
+                       _val_t, _hash_func, _equal_func)
+
+
+/**
+ * Initialize/destroy a hash table which was allocated by the caller.
+ */
+#define ucs_flat_hash_init(_name, _h)      ucs_flat_hash_init_##_name(_h)
+#define ucs_flat_hash_destroy(_name, _h)   ucs_flat_hash_destroy_##_name(_h)
+
+
+/**
+ * @return Iterator to the element with key @a _key, or @ref ucs_flat_hash_end
+ *         if not found.
+ */
+#define ucs_flat_hash_get(_name, _h, _key) \
+    ucs_flat_hash_get_##_name(_h, _key)
+
+
+/**
+ * Insert a key to the hash table, if not present. The value of a new element
+ * is not initialized.
+ *
+ * @return Iterator to the element with key @a _key.
+ */
+#define ucs_flat_hash_put(_name, _h, _key, _ret_p) \
+    ucs_flat_hash_put_##_name(_h, _key, _ret_p)
+
+
+/**
+ * Remove the element at iterator @a _it.
+ */
+#define ucs_flat_hash_del(_name, _h, _it) \
+    ucs_flat_hash_del_##_name(_h, _it)
+
+
+#define ucs_flat_hash_end(_h)              ((_h)->capacity)
+#define ucs_flat_hash_size(_h)             ((_h)->size)
+#define ucs_flat_hash_exist(_h, _it)       ((_h)->ctrl[_it] >= 0)
+#define ucs_flat_hash_key(_h, _it)         ((_h)->slots[_it].key)
+#define ucs_flat_hash_value(_h, _it)       ((_h)->slots[_it].value)
+
+
+/**
+ * Iterate over all values in the hash table. Removing the current element
+ * from @a _code is allowed.
+ */
+#define ucs_flat_hash_foreach_value(_h, _vvar, _code) \
+    { \
+        ucs_flat_hash_iter_t __i; \
+        for (__i = 0; __i != ucs_flat_hash_end(_h); ++__i) { \
+            if (!ucs_flat_hash_exist(_h, __i)) { \
+                continue; \
+            } \
+            (_vvar) = ucs_flat_hash_value(_h, __i); \
+            _code; \
+        } \
+    }
+
+
+/**
+ * Iterate over all keys and values in the hash table.
+ */
+#define ucs_flat_hash_foreach(_h, _kvar, _vvar, _code) \
+    { \
+        ucs_flat_hash_iter_t __i; \
+        for (__i = 0; __i != ucs_flat_hash_end(_h); ++__i) { \
+            if (!ucs_flat_hash_exist(_h, __i)) { \
+                continue; \
+            } \
+            (_kvar) = ucs_flat_hash_key(_h, __i); \
+            (_vvar) = ucs_flat_hash_value(_h, __i); \
+            _code; \
+        } \
+    }
+
+END_C_DECLS
+
+#endif
@@ -0,0 +1,236 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2019.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+#include "mpmc_ring.h"
+
+#include <ucs/arch/atomic.h>
+#include <ucs/debug/assert.h>
+#include <ucs/debug/memtrack.h>
+#include <ucs/sys/math.h>
+#include <string.h>
+
+
+/* Every slot starts with its sequence number, followed by the element data */
+typedef struct ucs_mpmc_ring_slot {
+    volatile uint32_t sequence;
+    uint32_t          pad;
+    char              data[0];
+} ucs_mpmc_ring_slot_t;
+
+
+static UCS_F_ALWAYS_INLINE ucs_mpmc_ring_slot_t *
+ucs_mpmc_ring_slot(ucs_mpmc_ring_t *ring, uint32_t location)
+{
+    return UCS_PTR_BYTE_OFFSET(ring->slots,
+                               (location & ring->mask) * ring->slot_size);
+}
+
+/* Zero if the slot is free for the producer of 'location', negative if full */
+static UCS_F_ALWAYS_INLINE int32_t
+ucs_mpmc_ring_push_diff(ucs_mpmc_ring_t *ring, uint32_t location)
+{
+    return (int32_t)(ucs_mpmc_ring_slot(ring, location)->sequence - location);
+}
+
+/* Zero if the slot holds data for the consumer of 'location', negative if not
+ * produced yet */
+static UCS_F_ALWAYS_INLINE int32_t
+ucs_mpmc_ring_pull_diff(ucs_mpmc_ring_t *ring, uint32_t location)
+{
+    return (int32_t)(ucs_mpmc_ring_slot(ring, location)->sequence -
+                     (location + 1));
+}
+
+ucs_status_t ucs_mpmc_ring_init(ucs_mpmc_ring_t *ring, uint32_t length,
+                                size_t elem_size)
+{
+    ucs_mpmc_ring_slot_t *slot;
+    uint32_t i;
+
+    length = ucs_roundup_pow2(ucs_max(length, 2));
+    if ((length >= UCS_BIT(31)) || (elem_size == 0) ||
+        (elem_size > UINT32_MAX)) {
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    ring->producer  = 0;
+    ring->consumer  = 0;
+    ring->mask      = length - 1;
+    ring->elem_size = elem_size;
+    ring->slot_size = ucs_align_up_pow2(sizeof(*slot) + elem_size,
+                                        sizeof(uint64_t));
+    ring->slots     = ucs_memalign(UCS_SYS_CACHE_LINE_SIZE,
+                                   ring->slot_size * length, "mpmc_ring");
+    if (ring->slots == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    for (i = 0; i < length; ++i) {
+        slot           = ucs_mpmc_ring_slot(ring, i);
+        slot->sequence = i;
+    }
+
+    return UCS_OK;
+}
+
+void ucs_mpmc_ring_cleanup(ucs_mpmc_ring_t *ring)
+{
+    ucs_free(ring->slots);
+}
+
+ucs_status_t ucs_mpmc_ring_push(ucs_mpmc_ring_t *ring, const void *elem)
+{
+    ucs_mpmc_ring_slot_t *slot;
+    uint32_t location;
+    int32_t diff;
+
+    location = ring->producer;
+    for (;;) {
+        diff = ucs_mpmc_ring_push_diff(ring, location);
+        if (diff < 0) {
+            /* The slot was not consumed yet in previous lap - ring is full */
+            return UCS_ERR_EXCEEDS_LIMIT;
+        } else if ((diff == 0) &&
+                   (ucs_atomic_cswap32(&ring->producer, location,
+                                       location + 1) == location)) {
+            break;
+        }
+
+        /* Another producer took the slot */
+        location = ring->producer;
+    }
+
+    slot = ucs_mpmc_ring_slot(ring, location);
+    memcpy(slot->data, elem, ring->elem_size);
+    ucs_memory_cpu_store_fence();
+    slot->sequence = location + 1;
+    return UCS_OK;
+}
+
+ucs_status_t ucs_mpmc_ring_pull(ucs_mpmc_ring_t *ring, void *elem)
+{
+    ucs_mpmc_ring_slot_t *slot;
+    uint32_t location;
+    int32_t diff;
+
+    location = ring->consumer;
+    for (;;) {
+        diff = ucs_mpmc_ring_pull_diff(ring, location);
+        if (diff < 0) {
+            /* The slot was not produced yet */
+            return UCS_ERR_NO_PROGRESS;
+        } else if ((diff == 0) &&
+                   (ucs_atomic_cswap32(&ring->consumer, location,
+                                       location + 1) == location)) {
+            break;
+        }
+
+        /* Another consumer took the slot */
+        location = ring->consumer;
+    }
+
+    slot = ucs_mpmc_ring_slot(ring, location);
+    ucs_memory_cpu_load_fence();
+    memcpy(elem, slot->data, ring->elem_size);
+    ucs_memory_cpu_fence();
+    slot->sequence = location + ring->mask + 1;
+    return UCS_OK;
+}
+
+unsigned ucs_mpmc_ring_push_n(ucs_mpmc_ring_t *ring, const void *elems,
+                              unsigned count)
+{
+    ucs_mpmc_ring_slot_t *slot;
+    uint32_t location;
+    unsigned i, n;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    count    = ucs_min(count, ring->mask + 1);
+    location = ring->producer;
+    for (;;) {
+        /* Count how many consecutive slots are free for this lap */
+        for (n = 0; n < count; ++n) {
+            if (ucs_mpmc_ring_push_diff(ring, location + n) != 0) {
+                break;
+            }
+        }
+
+        if ((n == 0) && (ucs_mpmc_ring_push_diff(ring, location) < 0)) {
+            return 0;
+        } else if ((n > 0) &&
+                   (ucs_atomic_cswap32(&ring->producer, location,
+                                       location + n) == location)) {
+            break;
+        }
+
+        location = ring->producer;
+    }
+
+    for (i = 0; i < n; ++i) {
+        slot = ucs_mpmc_ring_slot(ring, location + i);
+        memcpy(slot->data, UCS_PTR_BYTE_OFFSET(elems, i * ring->elem_size),
+               ring->elem_size);
+    }
+
+    ucs_memory_cpu_store_fence();
+    for (i = 0; i < n; ++i) {
+        slot           = ucs_mpmc_ring_slot(ring, location + i);
+        slot->sequence = location + i + 1;
+    }
+
+    return n;
+}
+
+unsigned ucs_mpmc_ring_pull_n(ucs_mpmc_ring_t *ring, void *elems,
+                              unsigned max_count)
+{
+    ucs_mpmc_ring_slot_t *slot;
+    uint32_t location;
+    unsigned i, n;
+
+    if (max_count == 0) {
+        return 0;
+    }
+
+    max_count = ucs_min(max_count, ring->mask + 1);
+    location  = ring->consumer;
+    for (;;) {
+        /* Count how many consecutive slots were produced for this lap */
+        for (n = 0; n < max_count; ++n) {
+            if (ucs_mpmc_ring_pull_diff(ring, location + n) != 0) {
+                break;
+            }
+        }
+
+        if ((n == 0) && (ucs_mpmc_ring_pull_diff(ring, location) < 0)) {
+            return 0;
+        } else if ((n > 0) &&
+                   (ucs_atomic_cswap32(&ring->consumer, location,
+                                       location + n) == location)) {
+            break;
+        }
+
+        location = ring->consumer;
+    }
+
+    ucs_memory_cpu_load_fence();
+    for (i = 0; i < n; ++i) {
+        slot = ucs_mpmc_ring_slot(ring, location + i);
+        memcpy(UCS_PTR_BYTE_OFFSET(elems, i * ring->elem_size), slot->data,
+               ring->elem_size);
+    }
+
+    ucs_memory_cpu_fence();
+    for (i = 0; i < n; ++i) {
+        slot           = ucs_mpmc_ring_slot(ring, location + i);
+        slot->sequence = location + i + ring->mask + 1;
+    }
+
+    return n;
+}
@@ -0,0 +1,132 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2019.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+#ifndef UCS_MPMC_RING_H
+#define UCS_MPMC_RING_H
+
+#include <ucs/arch/cpu.h>
+#include <ucs/type/status.h>
+#include <ucs/sys/compiler_def.h>
+#include <stddef.h>
+#include <stdint.h>
+
+BEGIN_C_DECLS
+
+/**
+ * A bounded, lock-free, multi-producer-multi-consumer ring of fixed-size
+ * elements.
+ *
+ * Every slot carries a sequence number which tells whether it is free for the
+ * producer of the current lap or holds data for the consumer of the current
+ * lap, so producers and consumers synchronize only on the slot they access and
+ * on their own index (D. Vyukov's bounded MPMC queue). Batch operations claim
+ * several consecutive slots with a single atomic operation.
+ *
+ * Producer index, consumer index and the read-only part are placed on separate
+ * cache lines, to avoid false sharing between producers and consumers.
+ */
+typedef struct ucs_mpmc_ring {
+    volatile uint32_t producer UCS_V_ALIGNED(UCS_SYS_CACHE_LINE_SIZE);
+    volatile uint32_t consumer UCS_V_ALIGNED(UCS_SYS_CACHE_LINE_SIZE);
+    uint32_t          mask     UCS_V_ALIGNED(UCS_SYS_CACHE_LINE_SIZE);
+    uint32_t          elem_size;    /* Size of a single element */
+    size_t            slot_size;    /* Element size plus sequence number */
+    void              *slots;       /* Array of slots */
+} ucs_mpmc_ring_t;
+
+
+/**
+ * Initialize MPMC ring.
+ *
+ * @param ring       Ring to initialize.
+ * @param length     Maximal number of elements, rounded up to a power of 2.
+ * @param elem_size  Size of every element in the ring.
+ */
+ucs_status_t ucs_mpmc_ring_init(ucs_mpmc_ring_t *ring, uint32_t length,
+                                size_t elem_size);
+
+
+/**
+ * Destroy MPMC ring.
+ */
+void ucs_mpmc_ring_cleanup(ucs_mpmc_ring_t *ring);
+
+
+/**
+ * Push an element to the ring.
+ *
+ * @param elem    Element to copy into the ring.
+ * @return UCS_ERR_EXCEEDS_LIMIT if the ring is full.
+ */
+ucs_status_t ucs_mpmc_ring_push(ucs_mpmc_ring_t *ring, const void *elem);
+
+
+/**
+ * Pull an element from the ring.
+ *
+ * @param elem    Filled with the element, if successful.
+ * @return UCS_ERR_NO_PROGRESS if there is currently no element to retrieve.
+ */
+ucs_status_t ucs_mpmc_ring_pull(ucs_mpmc_ring_t *ring, void *elem);
+
+
+/**
+ * Push up to @a count consecutive elements to the ring. The elements which
+ * were pushed will be pulled in the same order, without elements from other
+ * producers interleaved between them.
+ *
+ * @param elems   Array of elements to copy into the ring.
+ * @param count   Number of elements in the array.
+ * @return Number of elements which were pushed, 0 if the ring is full.
+ */
+unsigned ucs_mpmc_ring_push_n(ucs_mpmc_ring_t *ring, const void *elems,
+                              unsigned count);
+
+
+/**
+ * Pull up to @a max_count elements from the ring.
+ *
+ * @param elems      Array to fill with the elements.
+ * @param max_count  Maximal number of elements to pull.
+ * @return Number of elements which were pulled, 0 if the ring is empty.
+ */
+unsigned ucs_mpmc_ring_pull_n(ucs_mpmc_ring_t *ring, void *elems,
+                              unsigned max_count);
+
+
+/**
+ * Push a pointer to a ring which was initialized with element size of a
+ * pointer.
+ */
+static inline ucs_status_t ucs_mpmc_ring_push_ptr(ucs_mpmc_ring_t *ring,
+                                                  void *ptr)
+{
+    return ucs_mpmc_ring_push(ring, &ptr);
+}
+
+
+/**
+ * Pull a pointer from a ring which was initialized with element size of a
+ * pointer.
+ */
+static inline ucs_status_t ucs_mpmc_ring_pull_ptr(ucs_mpmc_ring_t *ring,
+                                                  void **ptr_p)
+{
+    return ucs_mpmc_ring_pull(ring, ptr_p);
+}
+
+
+/**
+ * @return nonzero if ring is empty, 0 if ring *may* be non-empty.
+ */
+static inline int ucs_mpmc_ring_is_empty(ucs_mpmc_ring_t *ring)
+{
+    return ring->producer == ring->consumer;
+}
+
+END_C_DECLS
+
+#endif
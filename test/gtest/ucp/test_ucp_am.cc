@@ -0,0 +1,165 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2019.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+#include "ucp_test.h"
+
+extern "C" {
+#include <ucp/api/ucpx.h>
+}
+
+
+class test_ucp_am : public ucp_test {
+public:
+    static ucp_params_t get_ctx_params() {
+        ucp_params_t params = ucp_test::get_ctx_params();
+        params.field_mask  |= UCP_PARAM_FIELD_FEATURES;
+        params.features     = UCP_FEATURE_EXPERIMENTAL;
+        return params;
+    }
+
+    virtual void init() {
+        ucp_test::init();
+        sender().connect(&receiver(), get_ep_params());
+        if (!is_loopback()) {
+            receiver().connect(&sender(), get_ep_params());
+        }
+
+        m_recv_flag   = false;
+        m_recv_flags  = 0;
+        m_recv_length = 0;
+        m_reply_ep    = NULL;
+    }
+
+protected:
+    static const uint16_t AM_ID     = 5;
+    static const size_t   LONG_SIZE = 64 * UCS_KBYTE;
+
+    static void send_cb(void *request, ucs_status_t status) {}
+
+    static ucs_status_t am_cb(void *arg, void *data, size_t length,
+                              ucp_ep_h reply_ep, unsigned flags) {
+        test_ucp_am *self = reinterpret_cast<test_ucp_am*>(arg);
+
+        self->m_recv_data.assign(reinterpret_cast<char*>(data),
+                                 reinterpret_cast<char*>(data) + length);
+        self->m_recv_in_buffer = !self->m_user_buffer.empty() &&
+                                 (data == &self->m_user_buffer[0]);
+        self->m_recv_flags     = flags;
+        self->m_recv_length    = length;
+        self->m_reply_ep       = reply_ep;
+        self->m_recv_flag      = true;
+        return UCS_OK;
+    }
+
+    static void *am_buffer_cb(void *arg, size_t length, ucp_ep_h reply_ep) {
+        test_ucp_am *self = reinterpret_cast<test_ucp_am*>(arg);
+
+        self->m_user_buffer.resize(length);
+        return &self->m_user_buffer[0];
+    }
+
+    void set_handlers(bool recv_buffer) {
+        ucs_status_t status;
+
+        status = ucp_worker_set_am_handler(receiver().worker(), AM_ID, am_cb,
+                                           this, UCP_AM_FLAG_WHOLE_MSG);
+        ASSERT_UCS_OK(status);
+
+        if (recv_buffer) {
+            status = ucp_worker_set_am_recv_buffer_handler(receiver().worker(),
+                                                           AM_ID, am_buffer_cb);
+            ASSERT_UCS_OK(status);
+        }
+    }
+
+    void do_send_recv(size_t size, unsigned flags, bool recv_buffer) {
+        std::vector<char> sbuf(size, 0);
+        void *sreq;
+
+        ucs::fill_random(sbuf);
+        m_user_buffer.clear();
+        m_recv_in_buffer = false;
+        m_recv_flag      = false;
+
+        sreq = ucp_am_send_nb(sender().ep(), AM_ID, &sbuf[0], size,
+                              ucp_dt_make_contig(1), send_cb, flags);
+        wait(sreq);
+        wait_for_flag(&m_recv_flag);
+
+        ASSERT_TRUE(m_recv_flag) << "size " << size;
+        EXPECT_EQ(size, m_recv_length);
+        EXPECT_EQ(sbuf, m_recv_data);
+
+        if (flags & UCP_AM_SEND_REPLY) {
+            EXPECT_TRUE(m_reply_ep != NULL);
+        } else {
+            EXPECT_TRUE(m_reply_ep == NULL);
+        }
+
+        if (m_recv_in_buffer) {
+            /* data in a user buffer is not owned by UCP */
+            EXPECT_TRUE(recv_buffer);
+            EXPECT_FALSE(m_recv_flags & UCP_CB_PARAM_FLAG_DATA);
+        } else {
+            EXPECT_TRUE(m_recv_flags & UCP_CB_PARAM_FLAG_DATA);
+        }
+    }
+
+    void test_send_recv(unsigned flags, bool recv_buffer) {
+        set_handlers(recv_buffer);
+
+        for (size_t size = 1; size <= (4 * UCS_MBYTE); size *= 4) {
+            do_send_recv(size, flags, recv_buffer);
+            if (recv_buffer && (size >= LONG_SIZE)) {
+                /* fragmented and rendezvous data lands in the user buffer */
+                EXPECT_TRUE(m_recv_in_buffer) << "size " << size;
+            }
+        }
+    }
+
+    std::vector<char> m_recv_data;
+    std::vector<char> m_user_buffer;
+    volatile bool     m_recv_flag;
+    bool              m_recv_in_buffer;
+    unsigned          m_recv_flags;
+    size_t            m_recv_length;
+    ucp_ep_h          m_reply_ep;
+};
+
+UCS_TEST_P(test_ucp_am, send_recv) {
+    test_send_recv(0, false);
+}
+
+UCS_TEST_P(test_ucp_am, send_recv_reply) {
+    test_send_recv(UCP_AM_SEND_REPLY, false);
+}
+
+UCS_TEST_P(test_ucp_am, send_recv_rndv, "RNDV_THRESH=16k") {
+    test_send_recv(0, false);
+}
+
+UCS_TEST_P(test_ucp_am, send_recv_rndv_reply, "RNDV_THRESH=16k") {
+    test_send_recv(UCP_AM_SEND_REPLY, false);
+}
+
+UCS_TEST_P(test_ucp_am, recv_buffer_multi, "RNDV_THRESH=inf") {
+    test_send_recv(0, true);
+}
+
+UCS_TEST_P(test_ucp_am, recv_buffer_multi_reply, "RNDV_THRESH=inf") {
+    test_send_recv(UCP_AM_SEND_REPLY, true);
+}
+
+UCS_TEST_P(test_ucp_am, recv_buffer_rndv, "RNDV_THRESH=16k") {
+    test_send_recv(0, true);
+}
+
+UCS_TEST_P(test_ucp_am, recv_buffer_rndv_put, "RNDV_THRESH=16k",
+           "RNDV_SCHEME=put_zcopy") {
+    test_send_recv(0, true);
+}
+
+UCP_INSTANTIATE_TEST_CASE(test_ucp_am)
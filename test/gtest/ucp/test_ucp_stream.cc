@@ -12,6 +12,10 @@
 #include "ucp_datatype.h"
 #include "ucp_test.h"
 
+extern "C" {
+#include <ucp/api/ucpx.h>
+}
+
 
 class test_ucp_stream_base : public ucp_test {
 public:
@@ -127,11 +131,13 @@ public:
 
 protected:
     void do_send_recv_data_test(ucp_datatype_t datatype);
+    void do_send_recv_data_iov_test(size_t iovcnt);
     template <typename T, unsigned recv_flags>
     void do_send_recv_test(ucp_datatype_t datatype);
     template <typename T, unsigned recv_flags>
     void do_send_exp_recv_test(ucp_datatype_t datatype);
     void do_send_recv_data_recv_test(ucp_datatype_t datatype);
+    void do_send_recv_rndv_test(bool exp);
 
     /* for self-validation of generic datatype
      * NOTE: it's tested only with byte array data since it's recv completion
@@ -184,6 +190,47 @@ void test_ucp_stream::do_send_recv_data_test(ucp_datatype_t datatype)
     EXPECT_EQ(check_pattern, rbuf);
 }
 
+void test_ucp_stream::do_send_recv_data_iov_test(size_t iovcnt)
+{
+    std::vector<char>         sbuf(1024 * 1024, 's');
+    size_t                    ssize = 0; /* total send size in bytes */
+    std::vector<char>         check_pattern;
+    std::vector<ucp_dt_iov_t> iov(iovcnt);
+    ucs_status_ptr_t          sstatus;
+
+    /* send all msg sizes*/
+    for (size_t i = 3; i < sbuf.size(); i *= 2) {
+        ucs::fill_random(sbuf, i);
+        check_pattern.insert(check_pattern.end(), sbuf.begin(),
+                             sbuf.begin() + i);
+        ucp::data_type_desc_t dt_desc(DATATYPE, sbuf.data(), i);
+        sstatus = stream_send_nb(dt_desc);
+        EXPECT_FALSE(UCS_PTR_IS_ERR(sstatus));
+        wait(sstatus);
+        ssize += i;
+    }
+
+    std::vector<char> rbuf(ssize, 'r');
+    size_t            roffset = 0;
+    ssize_t           count;
+    do {
+        progress();
+        count = ucp_stream_recv_data_iov_nb(receiver().ep(), &iov[0], iovcnt);
+        ASSERT_GE(count, 0);
+        ASSERT_LE(size_t(count), iovcnt);
+
+        for (ssize_t i = 0; i < count; ++i) {
+            ASSERT_LE(roffset + iov[i].length, ssize);
+            memcpy(&rbuf[roffset], iov[i].buffer, iov[i].length);
+            roffset += iov[i].length;
+        }
+        ucp_stream_data_release_iov(receiver().ep(), &iov[0], count);
+    } while (roffset < ssize);
+
+    EXPECT_EQ(roffset, ssize);
+    EXPECT_EQ(check_pattern, rbuf);
+}
+
 template <typename T, unsigned recv_flags>
 void test_ucp_stream::do_send_recv_test(ucp_datatype_t datatype)
 {
@@ -400,10 +447,81 @@ void test_ucp_stream::do_send_recv_data_recv_test(ucp_datatype_t datatype)
     EXPECT_EQ(check_pattern, rbuf);
 }
 
+void test_ucp_stream::do_send_recv_rndv_test(bool exp)
+{
+    /* interleave eager and rendezvous sizes to check the stream order */
+    static const size_t sizes[] = { 100, 65536, 100, 262144, 7, 1048576,
+                                    131072, 100 };
+    static const size_t n_msgs  = sizeof(sizes) / sizeof(sizes[0]);
+
+    std::vector<std::vector<char> > sbufs(n_msgs);
+    std::vector<std::vector<char> > rbufs(n_msgs);
+    std::vector<void *>             rreqs;
+    std::vector<void *>             sreqs;
+    std::vector<char>               check_pattern;
+    size_t                          length;
+
+    for (size_t i = 0; i < n_msgs; ++i) {
+        sbufs[i].resize(sizes[i]);
+        ucs::fill_random(sbufs[i]);
+        check_pattern.insert(check_pattern.end(), sbufs[i].begin(),
+                             sbufs[i].end());
+        rbufs[i].resize(sizes[i], 'r');
+    }
+
+    if (exp) {
+        /* post receives of the exact sizes before the data arrives */
+        for (size_t i = 0; i < n_msgs; ++i) {
+            void *rreq = ucp_stream_recv_nb(receiver().ep(), &rbufs[i][0],
+                                            sizes[i], ucp_dt_make_contig(1),
+                                            ucp_recv_cb, &length,
+                                            UCP_STREAM_RECV_FLAG_WAITALL);
+            ASSERT_TRUE(UCS_PTR_IS_PTR(rreq));
+            rreqs.push_back(rreq);
+        }
+    }
+
+    for (size_t i = 0; i < n_msgs; ++i) {
+        ucp::data_type_desc_t dt_desc(ucp_dt_make_contig(1), &sbufs[i][0],
+                                      sizes[i]);
+        void *sreq = stream_send_nb(dt_desc);
+        ASSERT_FALSE(UCS_PTR_IS_ERR(sreq));
+        sreqs.push_back(sreq);
+    }
+
+    if (exp) {
+        for (size_t i = 0; i < n_msgs; ++i) {
+            EXPECT_EQ(sizes[i], wait_stream_recv(rreqs[i]));
+            EXPECT_EQ(sbufs[i], rbufs[i]) << "message " << i;
+        }
+    } else {
+        std::vector<char> rbuf;
+        while (rbuf.size() < check_pattern.size()) {
+            progress();
+            void *rdata = ucp_stream_recv_data_nb(receiver().ep(), &length);
+            ASSERT_FALSE(UCS_PTR_IS_ERR(rdata));
+            if (rdata != NULL) {
+                rbuf.insert(rbuf.end(), (char*)rdata, (char*)rdata + length);
+                ucp_stream_data_release(receiver().ep(), rdata);
+            }
+        }
+        EXPECT_EQ(check_pattern, rbuf);
+    }
+
+    for (size_t i = 0; i < n_msgs; ++i) {
+        wait(sreqs[i]);
+    }
+}
+
 UCS_TEST_P(test_ucp_stream, send_recv_data) {
     do_send_recv_data_test(DATATYPE);
 }
 
+UCS_TEST_P(test_ucp_stream, send_recv_data_iov) {
+    do_send_recv_data_iov_test(1);
+    do_send_recv_data_iov_test(16);
+}
+
 UCS_TEST_P(test_ucp_stream, send_iov_recv_data) {
     do_send_recv_data_test(DATATYPE_IOV);
 }
@@ -515,6 +633,19 @@ UCS_TEST_P(test_ucp_stream, send_recv_data_recv_iov) {
     do_send_recv_data_recv_test(DATATYPE_IOV);
 }
 
+UCS_TEST_P(test_ucp_stream, send_exp_recv_rndv, "RNDV_THRESH=16k") {
+    do_send_recv_rndv_test(true);
+}
+
+UCS_TEST_P(test_ucp_stream, send_exp_recv_rndv_put, "RNDV_THRESH=16k",
+           "RNDV_SCHEME=put_zcopy") {
+    do_send_recv_rndv_test(true);
+}
+
+UCS_TEST_P(test_ucp_stream, send_recv_data_rndv, "RNDV_THRESH=16k") {
+    do_send_recv_rndv_test(false);
+}
+
 UCS_TEST_P(test_ucp_stream, send_zero_ending_iov_recv_data) {
     const size_t min_size         = 1024;
     const size_t max_size         = min_size * 64;
@@ -0,0 +1,327 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2019.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+#include "ucp_test.h"
+
+extern "C" {
+#include <ucp/api/ucpx.h>
+#include <ucs/arch/atomic.h>
+}
+
+#include <pthread.h>
+
+
+class test_ucp_submit : public ucp_test {
+public:
+    enum {
+        VARIANT_DEFAULT,
+        VARIANT_MT_MUTEX
+    };
+
+    static ucp_params_t get_ctx_params() {
+        ucp_params_t params = ucp_test::get_ctx_params();
+        params.features |= UCP_FEATURE_TAG | UCP_FEATURE_RMA;
+        return params;
+    }
+
+    static std::vector<ucp_test_param>
+    enum_test_params(const ucp_params_t& ctx_params, const std::string& name,
+                     const std::string& test_case_name, const std::string& tls)
+    {
+        std::vector<ucp_test_param> result;
+
+        generate_test_params_variant(ctx_params, name, test_case_name, tls,
+                                     VARIANT_DEFAULT, result);
+        generate_test_params_variant(ctx_params, name, test_case_name + "/mt",
+                                     tls, VARIANT_DEFAULT, result,
+                                     MULTI_THREAD_WORKER);
+        generate_test_params_variant(ctx_params, name,
+                                     test_case_name + "/mt_mutex", tls,
+                                     VARIANT_MT_MUTEX, result,
+                                     MULTI_THREAD_WORKER);
+        return result;
+    }
+
+protected:
+    static const unsigned NUM_MSGS = 1000;
+    static const ucp_tag_t TAG     = 0x1337a880u;
+
+    struct completion {
+        volatile uint32_t count;
+        ucs_status_t      status;
+        volatile uint64_t length;
+    };
+
+    struct submit_args {
+        ucp_worker_h    worker;
+        ucp_submit_op_t op;
+        unsigned        count;
+        unsigned        stride;
+    };
+
+    virtual void init() {
+        if (GetParam().variant == VARIANT_MT_MUTEX) {
+            modify_config("USE_MT_MUTEX", "y");
+        }
+        ucp_test::init();
+        sender().connect(&receiver(), get_ep_params());
+    }
+
+    /* May be called from several progressing threads */
+    static void completion_cb(void *arg, ucs_status_t status,
+                              const ucp_tag_recv_info_t *info) {
+        completion *comp = reinterpret_cast<completion*>(arg);
+
+        if (status != UCS_OK) {
+            comp->status = status;
+        }
+        if (info != NULL) {
+            ucs_atomic_add64(&comp->length, info->length);
+        }
+        ucs_atomic_add32(&comp->count, 1);
+    }
+
+    struct progress_args {
+        ucp_worker_h       worker;
+        volatile uint32_t  stop;
+    };
+
+    static void *progress_thread(void *arg) {
+        progress_args *args = reinterpret_cast<progress_args*>(arg);
+
+        while (!args->stop) {
+            if (ucp_worker_progress(args->worker) == 0) {
+                /* Let the submitting threads run if the CPUs are oversubscribed */
+                sched_yield();
+            }
+        }
+        return NULL;
+    }
+
+    /* Submits 'count' operations, advancing the buffer by 'stride' bytes */
+    static void *submit_thread(void *arg) {
+        submit_args *args = reinterpret_cast<submit_args*>(arg);
+        ucp_submit_op_t op = args->op;
+        ucs_status_t status;
+
+        for (unsigned i = 0; i < args->count; ++i) {
+            op.buffer = (char*)args->op.buffer + (i * args->stride);
+            do {
+                status = ucp_worker_submit(args->worker, &op);
+                if (status == UCS_ERR_NO_RESOURCE) {
+                    sched_yield();
+                }
+            } while (status == UCS_ERR_NO_RESOURCE);
+            EXPECT_UCS_OK(status);
+        }
+
+        return NULL;
+    }
+
+    void wait_for_count(const completion &comp, unsigned count,
+                        double timeout = 10.0) {
+        ucs_time_t deadline = ucs_get_time() +
+                              ucs_time_from_sec(timeout *
+                                                ucs::test_time_multiplier());
+        while ((comp.count < count) && (ucs_get_time() < deadline)) {
+            progress();
+        }
+        EXPECT_EQ(count, comp.count);
+    }
+};
+
+const unsigned  test_ucp_submit::NUM_MSGS;
+const ucp_tag_t test_ucp_submit::TAG;
+
+UCS_TEST_P(test_ucp_submit, disabled) {
+    ucp_submit_op_t op = {};
+    EXPECT_EQ(UCS_ERR_UNSUPPORTED, ucp_worker_submit(sender().worker(), &op));
+}
+
+UCS_TEST_P(test_ucp_submit, tag_send_recv, "SUBMIT_QUEUE_LEN=64") {
+    std::vector<uint64_t> send_buf(NUM_MSGS), recv_buf(NUM_MSGS, 0);
+    completion send_comp = {0, UCS_OK, 0}, recv_comp = {0, UCS_OK, 0};
+    submit_args send_args, recv_args;
+    pthread_t send_thread, recv_thread;
+
+    for (unsigned i = 0; i < NUM_MSGS; ++i) {
+        send_buf[i] = i * 0x9e3779b97f4a7c15ul;
+    }
+
+    memset(&recv_args, 0, sizeof(recv_args));
+    recv_args.worker       = receiver().worker();
+    recv_args.op.type      = UCP_SUBMIT_OP_TAG_RECV;
+    recv_args.op.buffer    = &recv_buf[0];
+    recv_args.op.count     = sizeof(uint64_t);
+    recv_args.op.datatype  = ucp_dt_make_contig(1);
+    recv_args.op.tag       = TAG;
+    recv_args.op.tag_mask  = (ucp_tag_t)-1;
+    recv_args.op.cb        = completion_cb;
+    recv_args.op.arg       = &recv_comp;
+    recv_args.count        = NUM_MSGS;
+    recv_args.stride       = sizeof(uint64_t);
+
+    send_args              = recv_args;
+    send_args.worker       = sender().worker();
+    send_args.op.type      = UCP_SUBMIT_OP_TAG_SEND;
+    send_args.op.ep        = sender().ep();
+    send_args.op.buffer    = &send_buf[0];
+    send_args.op.arg       = &send_comp;
+
+    /* Receives and sends are submitted concurrently, so some of the receives
+     * are matched with unexpected messages */
+    pthread_create(&recv_thread, NULL, submit_thread, &recv_args);
+    pthread_create(&send_thread, NULL, submit_thread, &send_args);
+
+    wait_for_count(send_comp, NUM_MSGS);
+    wait_for_count(recv_comp, NUM_MSGS);
+
+    pthread_join(send_thread, NULL);
+    pthread_join(recv_thread, NULL);
+
+    EXPECT_UCS_OK(send_comp.status);
+    EXPECT_UCS_OK(recv_comp.status);
+    EXPECT_EQ(NUM_MSGS * sizeof(uint64_t), recv_comp.length);
+    /* Messages with the same tag are matched in order */
+    for (unsigned i = 0; i < NUM_MSGS; ++i) {
+        EXPECT_EQ(send_buf[i], recv_buf[i]) << "index " << i;
+    }
+}
+
+UCS_TEST_P(test_ucp_submit, tag_send_recv_multi_thread, "SUBMIT_QUEUE_LEN=64") {
+    static const unsigned num_threads = MT_TEST_NUM_THREADS;
+    const unsigned count              = NUM_MSGS / num_threads;
+    std::vector<uint64_t> send_buf(count * num_threads);
+    std::vector<uint64_t> recv_buf(count * num_threads, 0);
+    completion send_comp = {0, UCS_OK, 0}, recv_comp = {0, UCS_OK, 0};
+    submit_args send_args[num_threads], recv_args[num_threads];
+    pthread_t send_threads[num_threads], recv_threads[num_threads];
+    progress_args prog_args;
+    pthread_t prog_thread;
+    /* When the worker is thread-safe, also start the submitted operations
+     * from another progressing thread */
+    bool mt_worker = ENABLE_MT &&
+                     (GetParam().thread_type == MULTI_THREAD_WORKER);
+
+    for (unsigned i = 0; i < send_buf.size(); ++i) {
+        send_buf[i] = i * 0x9e3779b97f4a7c15ul;
+    }
+
+    prog_args.worker = receiver().worker();
+    prog_args.stop   = 0;
+    if (mt_worker) {
+        pthread_create(&prog_thread, NULL, progress_thread, &prog_args);
+    }
+
+    /* Every pair of threads uses its own tag */
+    for (unsigned t = 0; t < num_threads; ++t) {
+        memset(&recv_args[t], 0, sizeof(recv_args[t]));
+        recv_args[t].worker      = receiver().worker();
+        recv_args[t].op.type     = UCP_SUBMIT_OP_TAG_RECV;
+        recv_args[t].op.buffer   = &recv_buf[t * count];
+        recv_args[t].op.count    = sizeof(uint64_t);
+        recv_args[t].op.datatype = ucp_dt_make_contig(1);
+        recv_args[t].op.tag      = TAG + t;
+        recv_args[t].op.tag_mask = (ucp_tag_t)-1;
+        recv_args[t].op.cb       = completion_cb;
+        recv_args[t].op.arg      = &recv_comp;
+        recv_args[t].count       = count;
+        recv_args[t].stride      = sizeof(uint64_t);
+
+        send_args[t]             = recv_args[t];
+        send_args[t].worker      = sender().worker();
+        send_args[t].op.type     = UCP_SUBMIT_OP_TAG_SEND;
+        send_args[t].op.ep       = sender().ep();
+        send_args[t].op.buffer   = &send_buf[t * count];
+        send_args[t].op.arg      = &send_comp;
+
+        pthread_create(&recv_threads[t], NULL, submit_thread, &recv_args[t]);
+        pthread_create(&send_threads[t], NULL, submit_thread, &send_args[t]);
+    }
+
+    /* With more threads than CPUs, lock holders may be preempted while other
+     * threads spin on the worker lock, so allow more time */
+    wait_for_count(send_comp, count * num_threads, 60.0);
+    wait_for_count(recv_comp, count * num_threads, 60.0);
+
+    for (unsigned t = 0; t < num_threads; ++t) {
+        pthread_join(send_threads[t], NULL);
+        pthread_join(recv_threads[t], NULL);
+    }
+
+    if (mt_worker) {
+        prog_args.stop = 1;
+        pthread_join(prog_thread, NULL);
+    }
+
+    EXPECT_UCS_OK(send_comp.status);
+    EXPECT_UCS_OK(recv_comp.status);
+    EXPECT_EQ(recv_buf.size() * sizeof(uint64_t), recv_comp.length);
+    /* Messages with the same tag are matched in order */
+    for (unsigned i = 0; i < recv_buf.size(); ++i) {
+        EXPECT_EQ(send_buf[i], recv_buf[i]) << "index " << i;
+    }
+}
+
+UCS_TEST_P(test_ucp_submit, put_get, "SUBMIT_QUEUE_LEN=8") {
+    static const size_t size = 64 * UCS_KBYTE;
+    std::string src(size, 'a'), dst(size, 0), back(size, 0);
+    completion comp = {0, UCS_OK, 0};
+    ucp_mem_map_params_t params;
+    void *rkey_buffer;
+    size_t rkey_buffer_size;
+    ucp_rkey_h rkey;
+    ucp_mem_h memh;
+    submit_args args;
+    pthread_t thread;
+
+    for (size_t i = 0; i < size; ++i) {
+        src[i] = 'a' + (i % 26);
+    }
+
+    params.field_mask = UCP_MEM_MAP_PARAM_FIELD_ADDRESS |
+                        UCP_MEM_MAP_PARAM_FIELD_LENGTH;
+    params.address    = &dst[0];
+    params.length     = size;
+    ASSERT_UCS_OK(ucp_mem_map(receiver().ucph(), &params, &memh));
+    ASSERT_UCS_OK(ucp_rkey_pack(receiver().ucph(), memh, &rkey_buffer,
+                                &rkey_buffer_size));
+    ASSERT_UCS_OK(ucp_ep_rkey_unpack(sender().ep(), rkey_buffer, &rkey));
+    ucp_rkey_buffer_release(rkey_buffer);
+
+    memset(&args, 0, sizeof(args));
+    args.worker         = sender().worker();
+    args.op.type        = UCP_SUBMIT_OP_PUT;
+    args.op.ep          = sender().ep();
+    args.op.buffer      = &src[0];
+    args.op.count       = size;
+    args.op.remote_addr = (uintptr_t)&dst[0];
+    args.op.rkey        = rkey;
+    args.op.cb          = completion_cb;
+    args.op.arg         = &comp;
+    args.count          = 1;
+
+    pthread_create(&thread, NULL, submit_thread, &args);
+    wait_for_count(comp, 1);
+    pthread_join(thread, NULL);
+    flush_worker(sender());
+    EXPECT_UCS_OK(comp.status);
+    EXPECT_EQ(src, dst);
+
+    args.op.type   = UCP_SUBMIT_OP_GET;
+    args.op.buffer = &back[0];
+
+    pthread_create(&thread, NULL, submit_thread, &args);
+    wait_for_count(comp, 2);
+    pthread_join(thread, NULL);
+    EXPECT_UCS_OK(comp.status);
+    EXPECT_EQ(src, back);
+
+    ucp_rkey_destroy(rkey);
+    ASSERT_UCS_OK(ucp_mem_unmap(receiver().ucph(), memh));
+}
+
+UCP_INSTANTIATE_TEST_CASE(test_ucp_submit)
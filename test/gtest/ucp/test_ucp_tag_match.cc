@@ -9,6 +9,13 @@
 
 #include <common/test_helpers.h>
 
+extern "C" {
+#include <ucp/core/ucp_worker.h>
+#include <ucp/tag/tag_match.h>
+}
+
+#include <algorithm>
+
 using namespace ucs; /* For vector<char> serialization */
 
 
@@ -45,6 +52,15 @@ public:
     }
 
 protected:
+    /* Enough distinct tags to grow the tag hash tables a few times */
+    static const unsigned HASH_RESIZE_NUM_TAGS = 5000;
+
+    static ucp_tag_t hash_resize_tag(unsigned i)
+    {
+        /* Both the sender part and the message part of the tag vary */
+        return ((ucp_tag_t)i << 40) | (i * 3);
+    }
+
     static void recv_callback_release_req(void *request, ucs_status_t status,
                                           ucp_tag_recv_info_t *info)
     {
@@ -57,6 +73,7 @@ protected:
 };
 
 ucs_status_t test_ucp_tag_match::m_req_status = UCS_OK;
+const unsigned test_ucp_tag_match::HASH_RESIZE_NUM_TAGS;
 
 
 UCS_TEST_P(test_ucp_tag_match, send_recv_unexp) {
@@ -640,4 +657,396 @@ UCS_TEST_P(test_ucp_tag_match, rndv_exp_huge_mix) {
     }
 }
 
+UCS_TEST_P(test_ucp_tag_match, exp_hash_resize) {
+    ucp_tag_match_t *tm = &receiver().worker()->tm;
+    unsigned init_shift = tm->expected.hash_state.shift;
+    std::vector<uint64_t> recv_data(HASH_RESIZE_NUM_TAGS, 0);
+    std::vector<request*> reqs;
+
+    for (unsigned i = 0; i < HASH_RESIZE_NUM_TAGS; ++i) {
+        request *req = recv_nb(&recv_data[i], sizeof(recv_data[i]), DATATYPE,
+                               hash_resize_tag(i), UCP_TAG_MASK_FULL);
+        ASSERT_TRUE(!UCS_PTR_IS_ERR(req));
+        ASSERT_TRUE(req != NULL);
+        reqs.push_back(req);
+    }
+
+    EXPECT_EQ(HASH_RESIZE_NUM_TAGS, tm->expected.hash_state.count);
+    EXPECT_LT(tm->expected.hash_state.shift, init_shift);
+
+    /* Match the receives in reverse order of posting */
+    for (unsigned i = HASH_RESIZE_NUM_TAGS; i > 0; --i) {
+        uint64_t send_data = i - 1;
+        send_b(&send_data, sizeof(send_data), DATATYPE, hash_resize_tag(i - 1));
+    }
+
+    for (unsigned i = 0; i < HASH_RESIZE_NUM_TAGS; ++i) {
+        wait(reqs[i]);
+        EXPECT_EQ(UCS_OK, reqs[i]->status);
+        EXPECT_EQ(hash_resize_tag(i), reqs[i]->info.sender_tag);
+        EXPECT_EQ(i, recv_data[i]);
+        request_release(reqs[i]);
+    }
+
+    EXPECT_EQ(0u, tm->expected.hash_state.count);
+
+    /* The table shrinks back while new receives are posted. Post a wildcard
+     * receive after every specific one, to check the specific receive, which
+     * was posted first, is still matched first. */
+    for (unsigned i = 0; i < HASH_RESIZE_NUM_TAGS / 4; ++i) {
+        uint64_t send_data = i, data = 0, wild_data = 0;
+        request *req, *wild_req;
+
+        req      = recv_nb(&data, sizeof(data), DATATYPE, hash_resize_tag(i),
+                           UCP_TAG_MASK_FULL);
+        wild_req = recv_nb(&wild_data, sizeof(wild_data), DATATYPE, 0, 0);
+        ASSERT_TRUE(!UCS_PTR_IS_ERR(req));
+        ASSERT_TRUE(!UCS_PTR_IS_ERR(wild_req));
+
+        send_b(&send_data, sizeof(send_data), DATATYPE, hash_resize_tag(i));
+        wait(req);
+        EXPECT_EQ(i, data);
+        EXPECT_FALSE(wild_req->completed);
+
+        send_b(&send_data, sizeof(send_data), DATATYPE, 0);
+        wait(wild_req);
+        EXPECT_EQ(i, wild_data);
+
+        request_release(req);
+        request_release(wild_req);
+    }
+
+    EXPECT_EQ(init_shift, tm->expected.hash_state.shift);
+}
+
+UCS_TEST_P(test_ucp_tag_match, unexp_hash_resize) {
+    ucp_tag_match_t *tm = &receiver().worker()->tm;
+    unsigned init_shift = tm->unexpected.hash_state.shift;
+    std::vector<unsigned> order;
+    ucp_tag_recv_info_t info;
+    ucs_status_t status;
+    ucs_time_t deadline;
+    uint64_t data;
+
+    for (unsigned i = 0; i < HASH_RESIZE_NUM_TAGS; ++i) {
+        data = i;
+        send_b(&data, sizeof(data), DATATYPE, hash_resize_tag(i));
+        order.push_back(i);
+    }
+
+    deadline = ucs_get_time() + ucs_time_from_sec(10.0);
+    while ((tm->unexpected.hash_state.count < HASH_RESIZE_NUM_TAGS) &&
+           (ucs_get_time() < deadline)) {
+        progress();
+    }
+
+    ASSERT_EQ(HASH_RESIZE_NUM_TAGS, tm->unexpected.hash_state.count);
+    EXPECT_LT(tm->unexpected.hash_state.shift, init_shift);
+
+    std::random_shuffle(order.begin(), order.end());
+    for (unsigned i = 0; i < HASH_RESIZE_NUM_TAGS; ++i) {
+        data   = 0;
+        status = recv_b(&data, sizeof(data), DATATYPE,
+                        hash_resize_tag(order[i]), UCP_TAG_MASK_FULL, &info);
+        ASSERT_UCS_OK(status);
+        EXPECT_EQ(hash_resize_tag(order[i]), info.sender_tag);
+        EXPECT_EQ(order[i], data);
+    }
+
+    EXPECT_EQ(0u, tm->unexpected.hash_state.count);
+}
+
+UCS_TEST_P(test_ucp_tag_match, exp_mask_index) {
+    /* Like MPI_ANY_SOURCE: sender in the high bits, the mask is on the rest */
+    const ucp_tag_t any_src = 0xffffffffull;
+    const unsigned num_tags = 100;
+    ucp_tag_match_t *tm     = &receiver().worker()->tm;
+    std::vector<uint64_t> recv_data(num_tags, 0);
+    std::vector<request*> reqs;
+    uint64_t spec_data = 0, late_data = 0, wild_data = 0, send_data;
+    request *spec_req, *late_req, *wild_req;
+
+    for (unsigned t = 0; t < num_tags; ++t) {
+        request *req = recv_nb(&recv_data[t], sizeof(recv_data[t]), DATATYPE,
+                               t, any_src);
+        ASSERT_TRUE(!UCS_PTR_IS_ERR(req));
+        reqs.push_back(req);
+    }
+
+    EXPECT_EQ(any_src, tm->expected.mask_index[0].tag_mask);
+    EXPECT_EQ(num_tags, tm->expected.mask_index[0].count);
+
+    /* Requests which can match tag 7 from sender 5, in posting order */
+    spec_req = recv_nb(&spec_data, sizeof(spec_data), DATATYPE,
+                       (5ull << 32) | 7, UCP_TAG_MASK_FULL);
+    late_req = recv_nb(&late_data, sizeof(late_data), DATATYPE, 7, any_src);
+    wild_req = recv_nb(&wild_data, sizeof(wild_data), DATATYPE, 0, 0);
+    ASSERT_TRUE(!UCS_PTR_IS_ERR(spec_req));
+    ASSERT_TRUE(!UCS_PTR_IS_ERR(late_req));
+    ASSERT_TRUE(!UCS_PTR_IS_ERR(wild_req));
+
+    send_data = 1;
+    send_b(&send_data, sizeof(send_data), DATATYPE, (3ull << 32) | 7);
+    wait(reqs[7]);
+    EXPECT_EQ(1u, recv_data[7]);
+
+    send_data = 2;
+    send_b(&send_data, sizeof(send_data), DATATYPE, (5ull << 32) | 7);
+    wait(spec_req);
+    EXPECT_EQ(2u, spec_data);
+
+    send_data = 3;
+    send_b(&send_data, sizeof(send_data), DATATYPE, (5ull << 32) | 7);
+    wait(late_req);
+    EXPECT_EQ(3u, late_data);
+
+    send_data = 4;
+    send_b(&send_data, sizeof(send_data), DATATYPE, (5ull << 32) | 7);
+    wait(wild_req);
+    EXPECT_EQ(4u, wild_data);
+
+    for (unsigned t = 0; t < num_tags; ++t) {
+        if (t != 7) {
+            send_data = t + 10;
+            send_b(&send_data, sizeof(send_data), DATATYPE,
+                   ((ucp_tag_t)t << 32) | t);
+        }
+    }
+
+    for (unsigned t = 0; t < num_tags; ++t) {
+        if (t != 7) {
+            wait(reqs[t]);
+            EXPECT_EQ(UCS_OK, reqs[t]->status);
+            EXPECT_EQ(t + 10, recv_data[t]);
+            EXPECT_EQ(((ucp_tag_t)t << 32) | t, reqs[t]->info.sender_tag);
+        }
+        request_release(reqs[t]);
+    }
+
+    request_release(spec_req);
+    request_release(late_req);
+    request_release(wild_req);
+
+    EXPECT_EQ(0u, tm->expected.mask_index[0].count);
+    EXPECT_EQ(0u, tm->expected.wild_count);
+}
+
+UCS_TEST_P(test_ucp_tag_match, unexp_mask_index) {
+    const ucp_tag_t any_src    = 0xffffffffull;
+    const unsigned num_tags    = 50;
+    const unsigned num_senders = 8;
+    ucp_tag_match_t *tm        = &receiver().worker()->tm;
+    ucp_tag_recv_info_t info;
+    ucs_status_t status;
+    ucs_time_t deadline;
+    uint64_t data;
+
+    for (unsigned i = 0; i < num_tags * num_senders; ++i) {
+        data = i;
+        send_b(&data, sizeof(data), DATATYPE,
+               ((ucp_tag_t)(i % num_senders) << 32) | (i / num_senders));
+    }
+
+    deadline = ucs_get_time() + ucs_time_from_sec(10.0);
+    while ((tm->unexpected.hash_state.count < num_tags * num_senders) &&
+           (ucs_get_time() < deadline)) {
+        progress();
+    }
+    ASSERT_EQ(num_tags * num_senders, tm->unexpected.hash_state.count);
+
+    /* Receive every tag from any sender, in reverse order of tags, which
+     * creates the index after a few searches. Messages with the same tag
+     * must be received in arrival order. */
+    for (unsigned t = num_tags; t > 0; --t) {
+        for (unsigned s = 0; s < num_senders; ++s) {
+            data   = 0;
+            status = recv_b(&data, sizeof(data), DATATYPE, t - 1, any_src,
+                            &info);
+            ASSERT_UCS_OK(status);
+            EXPECT_EQ(((ucp_tag_t)s << 32) | (t - 1), info.sender_tag);
+            EXPECT_EQ((t - 1) * num_senders + s, data);
+        }
+
+        /* Search with another mask, which should not replace the index */
+        if (t % 4 == 0) {
+            EXPECT_TRUE(ucp_tag_probe_nb(receiver().worker(), 0,
+                                         0xff00000000ull, 0, &info) != NULL);
+        }
+    }
+
+    EXPECT_EQ(any_src, tm->unexpected.mask_index.tag_mask);
+    EXPECT_TRUE(tm->unexpected.mask_index.hash != NULL);
+    EXPECT_EQ(0u, tm->unexpected.hash_state.count);
+}
+
+UCS_TEST_P(test_ucp_tag_match, recv_batch) {
+    const size_t num_recvs = 64;
+    ucp_tag_match_t *tm    = &receiver().worker()->tm;
+    std::vector<ucp_tag_recv_batch_elem_t> elems(num_recvs);
+    std::vector<ucp_tag_recv_info_t> info(num_recvs);
+    std::vector<uint64_t> recv_data(num_recvs, 0);
+    ucp_tag_recv_batch_h batch;
+    ucs_status_t status;
+    ucs_time_t deadline;
+    uint64_t send_data;
+
+    /* Half of the messages arrive before the receives are posted */
+    for (size_t i = 0; i < num_recvs / 2; ++i) {
+        send_data = i;
+        send_b(&send_data, sizeof(send_data), DATATYPE, i * 2);
+    }
+
+    deadline = ucs_get_time() + ucs_time_from_sec(10.0);
+    while ((tm->unexpected.hash_state.count < num_recvs / 2) &&
+           (ucs_get_time() < deadline)) {
+        progress();
+    }
+    ASSERT_EQ(num_recvs / 2, tm->unexpected.hash_state.count);
+
+    for (size_t i = 0; i < num_recvs; ++i) {
+        elems[i].buffer   = &recv_data[i];
+        elems[i].count    = sizeof(recv_data[i]);
+        elems[i].datatype = DATATYPE;
+        elems[i].tag      = i;
+        elems[i].tag_mask = UCP_TAG_MASK_FULL;
+    }
+
+    status = ucp_tag_recv_batch_nb(receiver().worker(), &elems[0], num_recvs,
+                                   &batch);
+    ASSERT_UCS_OK(status);
+    EXPECT_EQ(0u, tm->unexpected.hash_state.count);
+    EXPECT_EQ(UCS_INPROGRESS, ucp_tag_recv_batch_test(batch, &info[0]));
+
+    for (size_t i = 0; i < num_recvs / 2; ++i) {
+        send_data = num_recvs + i;
+        send_b(&send_data, sizeof(send_data), DATATYPE, i * 2 + 1);
+    }
+
+    deadline = ucs_get_time() + ucs_time_from_sec(10.0);
+    do {
+        progress();
+        status = ucp_tag_recv_batch_test(batch, &info[0]);
+    } while ((status == UCS_INPROGRESS) && (ucs_get_time() < deadline));
+    ASSERT_UCS_OK(status);
+
+    for (size_t i = 0; i < num_recvs; ++i) {
+        EXPECT_EQ((i % 2) ? (num_recvs + i / 2) : (i / 2), recv_data[i]);
+        EXPECT_EQ((ucp_tag_t)i, info[i].sender_tag);
+        EXPECT_EQ(sizeof(uint64_t), info[i].length);
+    }
+    ucp_tag_recv_batch_free(batch);
+
+    /* Receives which are not completed are canceled by releasing the batch */
+    status = ucp_tag_recv_batch_nb(receiver().worker(), &elems[0], num_recvs,
+                                   &batch);
+    ASSERT_UCS_OK(status);
+    EXPECT_EQ(UCS_INPROGRESS, ucp_tag_recv_batch_test(batch, NULL));
+    ucp_tag_recv_batch_free(batch);
+    EXPECT_EQ(0u, tm->expected.sw_all_count);
+}
+
 UCP_INSTANTIATE_TEST_CASE(test_ucp_tag_match)
+
+
+class test_ucp_tag_match_part : public test_ucp_tag_match {
+public:
+    virtual void init()
+    {
+        modify_config("TM_CHANNEL_BITS",  "2");
+        modify_config("TM_CHANNEL_SHIFT", "32");
+        test_ucp_tag_match::init();
+    }
+
+protected:
+    static const unsigned NUM_CHANNELS = 4;
+
+    static ucp_tag_t part_tag(unsigned sender, unsigned channel, unsigned msg)
+    {
+        return ((ucp_tag_t)sender << 40) | ((ucp_tag_t)channel << 32) | msg;
+    }
+};
+
+const unsigned test_ucp_tag_match_part::NUM_CHANNELS;
+
+
+UCS_TEST_P(test_ucp_tag_match_part, send_recv) {
+    /* Any sender, but the channel bits are matched */
+    const ucp_tag_t any_sender = 0xffffffffffull;
+    ucp_worker_h worker        = receiver().worker();
+    std::vector<uint64_t> recv_data(NUM_CHANNELS * 2, 0);
+    std::vector<request*> reqs;
+    ucs_time_t deadline;
+    uint64_t send_data;
+    unsigned num_unexp;
+
+    ASSERT_TRUE(worker->tm_parts != NULL);
+
+    for (unsigned c = 0; c < NUM_CHANNELS; ++c) {
+        send_data = c;
+        send_b(&send_data, sizeof(send_data), DATATYPE, part_tag(1, c, 7));
+    }
+
+    /* Unexpected messages are kept in the partition of their channel */
+    deadline = ucs_get_time() + ucs_time_from_sec(10.0);
+    do {
+        progress();
+        num_unexp = 0;
+        for (unsigned c = 0; c < NUM_CHANNELS; ++c) {
+            num_unexp += worker->tm_parts[c].unexpected.hash_state.count;
+        }
+    } while ((num_unexp < NUM_CHANNELS) && (ucs_get_time() < deadline));
+
+    for (unsigned c = 0; c < NUM_CHANNELS; ++c) {
+        EXPECT_EQ(1u, worker->tm_parts[c].unexpected.hash_state.count);
+    }
+    EXPECT_TRUE(ucp_tag_unexp_is_empty(&worker->tm));
+
+    /* The wildcard receive matches the unexpected message, and the specific
+     * receive waits in the partition */
+    for (unsigned c = 0; c < NUM_CHANNELS; ++c) {
+        reqs.push_back(recv_nb(&recv_data[c * 2], sizeof(uint64_t), DATATYPE,
+                               part_tag(0, c, 7), any_sender));
+        reqs.push_back(recv_nb(&recv_data[c * 2 + 1], sizeof(uint64_t),
+                               DATATYPE, part_tag(2, c, 7), UCP_TAG_MASK_FULL));
+        EXPECT_EQ(1u, worker->tm_parts[c].expected.sw_all_count);
+    }
+    EXPECT_EQ(0u, worker->tm.expected.sw_all_count);
+
+    for (unsigned c = 0; c < NUM_CHANNELS; ++c) {
+        send_data = c + 10;
+        send_b(&send_data, sizeof(send_data), DATATYPE, part_tag(2, c, 7));
+    }
+
+    for (unsigned c = 0; c < NUM_CHANNELS; ++c) {
+        wait(reqs[c * 2]);
+        wait(reqs[c * 2 + 1]);
+        EXPECT_EQ(c, recv_data[c * 2]);
+        EXPECT_EQ(part_tag(1, c, 7), reqs[c * 2]->info.sender_tag);
+        EXPECT_EQ(c + 10, recv_data[c * 2 + 1]);
+        EXPECT_EQ(part_tag(2, c, 7), reqs[c * 2 + 1]->info.sender_tag);
+        EXPECT_EQ(0u, worker->tm_parts[c].expected.sw_all_count);
+    }
+
+    for (unsigned i = 0; i < reqs.size(); ++i) {
+        request_release(reqs[i]);
+    }
+}
+
+UCS_TEST_P(test_ucp_tag_match_part, invalid_mask) {
+    /* The mask does not include the channel bits */
+    const ucp_tag_t tag_mask = 0xffffffffull;
+    ucp_tag_recv_info_t info;
+    ucs_status_ptr_t status_p;
+    uint64_t recv_data;
+
+    scoped_log_handler slh(hide_errors_logger);
+
+    status_p = ucp_tag_recv_nb(receiver().worker(), &recv_data,
+                               sizeof(recv_data), DATATYPE, 0, tag_mask,
+                               recv_callback);
+    EXPECT_EQ(UCS_ERR_INVALID_PARAM, UCS_PTR_STATUS(status_p));
+    EXPECT_TRUE(ucp_tag_probe_nb(receiver().worker(), 0, tag_mask, 0,
+                                 &info) == NULL);
+}
+
+UCP_INSTANTIATE_TEST_CASE(test_ucp_tag_match_part)
@@ -89,3 +89,53 @@ UCS_TEST_P(test_ucp_tag_mt, send_recv) {
 }
 
 UCP_INSTANTIATE_TEST_CASE(test_ucp_tag_mt)
+
+
+class test_ucp_tag_mt_part : public test_ucp_tag_mt {
+public:
+    virtual void init()
+    {
+        /* Every thread receives on its own tag-matching partition */
+        modify_config("TM_CHANNEL_BITS",  "2");
+        modify_config("TM_CHANNEL_SHIFT", "16");
+        test_ucp_tag_mt::init();
+    }
+};
+
+UCS_TEST_P(test_ucp_tag_mt_part, send_recv) {
+    int i;
+    uint64_t            send_data[MT_TEST_NUM_THREADS] GTEST_ATTRIBUTE_UNUSED_;
+    uint64_t            recv_data[MT_TEST_NUM_THREADS] GTEST_ATTRIBUTE_UNUSED_;
+    ucp_tag_recv_info_t info[MT_TEST_NUM_THREADS] GTEST_ATTRIBUTE_UNUSED_;
+
+    for (i = 0; i < MT_TEST_NUM_THREADS; i++) {
+        send_data[i] = 0xdeadbeefdeadbeef + 10 * i;
+        recv_data[i] = 0;
+    }
+
+#if _OPENMP && ENABLE_MT
+#pragma omp parallel for
+    for (i = 0; i < MT_TEST_NUM_THREADS; i++) {
+        ucp_tag_t channel = (ucp_tag_t)(i % 4) << 16;
+        ucs_status_t status;
+        int worker_index = 0;
+
+        if (GetParam().thread_type == MULTI_THREAD_CONTEXT) {
+            worker_index = i;
+        }
+
+        send_b(&(send_data[i]), sizeof(send_data[i]), DATATYPE,
+               0x1000000 | channel | 0x1337, i);
+
+        status = recv_b(&(recv_data[i]), sizeof(recv_data[i]), DATATYPE,
+                        channel | 0x1337, 0x3ffff, &(info[i]), i);
+        ASSERT_UCS_OK(status);
+
+        EXPECT_EQ(sizeof(send_data[i]), info[i].length);
+        EXPECT_EQ(0x1000000 | channel | 0x1337, info[i].sender_tag);
+        EXPECT_EQ(send_data[i], recv_data[i]);
+    }
+#endif
+}
+
+UCP_INSTANTIATE_TEST_CASE(test_ucp_tag_mt_part)
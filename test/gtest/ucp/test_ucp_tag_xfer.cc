@@ -552,6 +552,16 @@ UCS_TEST_P(test_ucp_tag_xfer, contig_exp_truncated) {
     test_xfer(&test_ucp_tag_xfer::test_xfer_contig, true, false, true);
 }
 
+UCS_TEST_P(test_ucp_tag_xfer, contig_exp_rndv_thresh_adapt, "RNDV_THRESH_ADAPT=y") {
+    /* Many messages of sizes around the threshold, so that both protocols are
+     * measured and the threshold is updated during the test */
+    long count = ucs_max((long)(1000 / ucs::test_time_multiplier()), 100);
+    for (long i = 0; i < count; ++i) {
+        size_t size = (size_t)pow(2.0, 8 + (ucs::rand() % 1200) / 100.0);
+        test_xfer_contig(size, true, false, false);
+    }
+}
+
 UCS_TEST_P(test_ucp_tag_xfer, contig_unexp) {
     test_xfer(&test_ucp_tag_xfer::test_xfer_contig, false, false, false);
 }
@@ -752,6 +762,16 @@ UCS_TEST_P(test_ucp_tag_xfer, send_contig_recv_contig_exp_rndv_probe, "RNDV_THRE
     test_xfer_probe(true, true, true, false);
 }
 
+UCS_TEST_P(test_ucp_tag_xfer, send_contig_recv_contig_exp_rndv_chunked, "RNDV_THRESH=1000",
+           "RNDV_CHUNK_SIZE=16k", "RNDV_CHUNK_WINDOW=2") {
+    test_run_xfer(true, true, true, false, false);
+}
+
+UCS_TEST_P(test_ucp_tag_xfer, send_contig_recv_contig_unexp_rndv_chunked, "RNDV_THRESH=1000",
+           "RNDV_CHUNK_SIZE=16k", "RNDV_CHUNK_WINDOW=2") {
+    test_run_xfer(true, true, false, false, false);
+}
+
 /* rndv send_generic_recv_generic am_rndv with bcopy on the sender side */
 
 UCS_TEST_P(test_ucp_tag_xfer, send_generic_recv_generic_exp_rndv, "RNDV_THRESH=1000") {
@@ -19,7 +19,8 @@ extern "C" {
 
 class base {
 public:
-    base(ucs_async_mode_t mode) : m_mode(mode), m_count(0), m_handler_set(0) {
+    base(ucs_async_mode_t mode) : m_mode(mode), m_count(0), m_handler_set(0),
+                                  m_thread(pthread_self()) {
     }
 
     virtual ~base() {
@@ -29,6 +30,11 @@ public:
         return m_count;
     }
 
+    /* Thread which dispatched the last event */
+    pthread_t thread() const {
+        return m_thread;
+    }
+
     void set_handler() {
         ASSERT_FALSE(m_handler_set);
         m_handler_set = 1;
@@ -58,6 +64,7 @@ protected:
     }
 
     virtual void handler() {
+        m_thread = pthread_self();
         ++m_count;
         ack_event();
     }
@@ -65,6 +72,7 @@ protected:
     const ucs_async_mode_t m_mode;
     int                    m_count;
     uint32_t               m_handler_set;
+    pthread_t              m_thread;
 };
 
 class base_event : public base {
@@ -204,6 +212,10 @@ public:
         ucs_async_poll(&m_async);
     }
 
+    unsigned shard() const {
+        return m_async.thread.shard;
+    }
+
 protected:
     ucs_async_context_t m_async;
 };
@@ -478,6 +490,69 @@ UCS_TEST_P(test_async, two_timers) {
     EXPECT_GE(lt2.count(), int(TIMER_EXP_COUNT));
 }
 
+UCS_TEST_P(test_async, thread_pool, "ASYNC_THREADS=3") {
+    static const unsigned NUM_CONTEXTS = 5;
+    static const unsigned NUM_THREADS  = 3;
+    std::vector<local_event*> events;
+    cpu_set_t cpu_mask;
+    int cpu;
+
+    /* Bind the threads to a CPU we are allowed to run on, and add one which
+     * is out of range - it should be ignored */
+    ASSERT_EQ(0, sched_getaffinity(0, sizeof(cpu_mask), &cpu_mask));
+    for (cpu = 0; !CPU_ISSET(cpu, &cpu_mask); ++cpu);
+    modify_config("ASYNC_THREAD_AFFINITY",
+                  ucs::to_string(cpu) + "," +
+                  ucs::to_string(CPU_SETSIZE - 1));
+
+    for (unsigned i = 0; i < NUM_CONTEXTS; ++i) {
+        events.push_back(new local_event(GetParam()));
+    }
+
+    local_timer lt(GetParam());
+    for (unsigned i = 0; i < NUM_CONTEXTS; ++i) {
+        events[i]->push_event();
+    }
+
+    for (int i = 0; i < TIMER_RETRIES; ++i) {
+        suspend_and_poll(&lt, COUNT * 4);
+        for (unsigned j = 0; j < NUM_CONTEXTS; ++j) {
+            if (GetParam() == UCS_ASYNC_MODE_POLL) {
+                events[j]->poll();
+            }
+        }
+        if (lt.count() >= TIMER_EXP_COUNT) {
+            break;
+        }
+        UCS_TEST_MESSAGE << "retry " << (i + 1);
+    }
+
+    EXPECT_GE(lt.count(), int(TIMER_EXP_COUNT));
+    for (unsigned i = 0; i < NUM_CONTEXTS; ++i) {
+        EXPECT_GE(events[i]->count(), 1) << "context " << i;
+    }
+
+    if ((GetParam() == UCS_ASYNC_MODE_THREAD_SPINLOCK) ||
+        (GetParam() == UCS_ASYNC_MODE_THREAD_MUTEX)) {
+        /* Contexts on the same shard are dispatched by the same thread, and
+         * contexts on different shards - by different threads */
+        for (unsigned i = 0; i < NUM_CONTEXTS; ++i) {
+            EXPECT_FALSE(pthread_equal(pthread_self(), events[i]->thread()));
+            for (unsigned j = 0; j < i; ++j) {
+                bool same_shard = (events[i]->shard() % NUM_THREADS) ==
+                                  (events[j]->shard() % NUM_THREADS);
+                EXPECT_EQ(same_shard, !!pthread_equal(events[i]->thread(),
+                                                      events[j]->thread()))
+                    << "contexts " << j << " and " << i;
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < NUM_CONTEXTS; ++i) {
+        delete events[i];
+    }
+}
+
 UCS_TEST_P(test_async, ctx_event_block) {
     local_event le(GetParam());
 
@@ -9,6 +9,7 @@ extern "C" {
 #include <ucs/arch/atomic.h>
 #include <ucs/async/async.h>
 #include <ucs/datastruct/callbackq.h>
+#include <ucs/stats/stats.h>
 }
 
 class test_callbackq :
@@ -362,3 +363,195 @@ UCS_TEST_F(test_callbackq_noflags, remove_if) {
     }
 }
 
+
+
+class test_callbackq_adaptive : public test_callbackq_noflags {
+protected:
+    struct poll_ctx {
+        unsigned count;  /* How many times the callback was called */
+        unsigned result; /* Value to return from the callback */
+    };
+
+    static unsigned poll_callback(void *arg)
+    {
+        poll_ctx *ctx = reinterpret_cast<poll_ctx*>(arg);
+        ++ctx->count;
+        return ctx->result;
+    }
+
+    int add_poll(poll_ctx *ctx, unsigned result)
+    {
+        ctx->count  = 0;
+        ctx->result = result;
+        return ucs_callbackq_add(&m_cbq, poll_callback,
+                                 reinterpret_cast<void*>(ctx),
+                                 UCS_CALLBACKQ_FLAG_FAST);
+    }
+};
+
+UCS_TEST_F(test_callbackq_adaptive, backoff, "PROGRESS_BACKOFF=16",
+           "PROGRESS_BACKOFF_THRESH=4") {
+    const unsigned num_iters = 1600;
+    poll_ctx idle_ctx, busy_ctx;
+    int idle_id, busy_id;
+
+    idle_id = add_poll(&idle_ctx, 0);
+    busy_id = add_poll(&busy_ctx, 1);
+
+    EXPECT_EQ(num_iters, dispatch(num_iters));
+    EXPECT_EQ(num_iters, busy_ctx.count);
+
+    /* The idle callback reaches the maximal interval after 4 idle calls on
+     * every interval: 4*(1 + 2 + 4 + 8) = 60 iterations */
+    EXPECT_GE(idle_ctx.count, num_iters / 16);
+    EXPECT_LE(idle_ctx.count, (num_iters / 16) + 60);
+
+    /* Once the idle callback finds work, it is called on every iteration */
+    idle_ctx.result = 1;
+    dispatch(16);
+    idle_ctx.count  = 0;
+    dispatch(100);
+    EXPECT_EQ(100u, idle_ctx.count);
+
+    ucs_callbackq_remove(&m_cbq, idle_id);
+    ucs_callbackq_remove(&m_cbq, busy_id);
+}
+
+UCS_TEST_F(test_callbackq_adaptive, disabled) {
+    poll_ctx idle_ctx;
+    int idle_id;
+
+    idle_id = add_poll(&idle_ctx, 0);
+    EXPECT_EQ(0u, dispatch(100));
+    EXPECT_EQ(100u, idle_ctx.count);
+    ucs_callbackq_remove(&m_cbq, idle_id);
+}
+
+UCS_TEST_F(test_callbackq_adaptive, remove_safe, "PROGRESS_BACKOFF=1024",
+           "PROGRESS_BACKOFF_THRESH=1") {
+    poll_ctx idle_ctx;
+    int idle_id;
+
+    /* Back off the callback, and then remove it lazily - it should not be
+     * called after the next dispatch */
+    idle_id = add_poll(&idle_ctx, 0);
+    dispatch(10000);
+    ucs_callbackq_remove_safe(&m_cbq, idle_id);
+    dispatch();
+    idle_ctx.count = 0;
+    dispatch(10000);
+    EXPECT_EQ(0u, idle_ctx.count);
+}
+
+
+class test_callbackq_stats : public test_callbackq_adaptive {
+protected:
+    struct remove_ctx {
+        test_callbackq_stats *test;
+        int                  id;
+        unsigned             count;
+    };
+
+    struct thread_args {
+        test_callbackq_stats *test;
+        volatile uint32_t    done;
+    };
+
+    virtual void init() {
+#if ENABLE_STATS
+        ucs_stats_cleanup();
+        push_config();
+        modify_config("STATS_DEST",    "file:/dev/null");
+        modify_config("STATS_TRIGGER", "");
+        ucs_stats_init();
+        ASSERT_TRUE(ucs_stats_is_active());
+#endif
+        test_callbackq_adaptive::init();
+        m_cbq.dispatch_flags |= UCS_CALLBACKQ_DISPATCH_STATS;
+    }
+
+    virtual void cleanup() {
+        ucs_callbackq_cleanup(&m_cbq);
+#if ENABLE_STATS
+        ucs_stats_cleanup();
+        pop_config();
+        ucs_stats_init();
+#endif
+        ucs::test_base::cleanup();
+    }
+
+    static unsigned remove_self_callback(void *arg)
+    {
+        remove_ctx *ctx = reinterpret_cast<remove_ctx*>(arg);
+        ++ctx->count;
+        ucs_callbackq_remove(&ctx->test->m_cbq, ctx->id);
+        return 1;
+    }
+
+    /* Adds and removes callbacks from another thread, which grows the ID
+     * lookup table and moves elements while the main thread dispatches */
+    static void *add_remove_thread(void *arg)
+    {
+        thread_args *args = reinterpret_cast<thread_args*>(arg);
+        ucs_callbackq_t *cbq = &args->test->m_cbq;
+        std::vector<poll_ctx> ctxs(200);
+        std::vector<int> ids(ctxs.size());
+
+        for (unsigned round = 0; round < 20; ++round) {
+            for (size_t i = 0; i < ctxs.size(); ++i) {
+                ctxs[i].count  = 0;
+                ctxs[i].result = i % 2;
+                ids[i] = ucs_callbackq_add_safe(cbq, poll_callback, &ctxs[i],
+                                                (i % 4) ? 0 :
+                                                UCS_CALLBACKQ_FLAG_FAST);
+            }
+            for (size_t i = 0; i < ctxs.size(); ++i) {
+                ucs_callbackq_remove_safe(cbq, ids[i]);
+            }
+        }
+
+        args->done = 1;
+        return NULL;
+    }
+};
+
+UCS_TEST_F(test_callbackq_stats, remove_self) {
+    poll_ctx ctx[3];
+    remove_ctx rctx;
+    int ids[3];
+
+    ids[0]     = add_poll(&ctx[0], 1);
+    rctx.test  = this;
+    rctx.count = 0;
+    rctx.id    = ucs_callbackq_add(&m_cbq, remove_self_callback, &rctx,
+                                   UCS_CALLBACKQ_FLAG_FAST);
+    ids[1]     = add_poll(&ctx[1], 0);
+    ids[2]     = add_poll(&ctx[2], 1);
+
+    /* The last element is moved to the place of the removed one, so it is
+     * skipped by the first dispatch */
+    EXPECT_EQ(20u, dispatch(10));
+    EXPECT_EQ(1u,  rctx.count);
+    EXPECT_EQ(10u, ctx[0].count);
+    EXPECT_EQ(10u, ctx[1].count);
+    EXPECT_EQ(9u,  ctx[2].count);
+    for (unsigned i = 0; i < 3; ++i) {
+        ucs_callbackq_remove(&m_cbq, ids[i]);
+    }
+}
+
+UCS_TEST_F(test_callbackq_stats, add_remove_safe_mt) {
+    thread_args args;
+    pthread_t thread;
+
+    args.test = this;
+    args.done = 0;
+    pthread_create(&thread, NULL, add_remove_thread, &args);
+    while (!args.done) {
+        dispatch();
+    }
+    pthread_join(thread, NULL);
+
+    /* Complete the lazy removals */
+    dispatch(10);
+}
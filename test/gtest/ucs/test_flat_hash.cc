@@ -0,0 +1,282 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2019.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+#include <common/test.h>
+extern "C" {
+#include <ucs/datastruct/flat_hash.h>
+#include <ucs/datastruct/khash.h>
+#include <ucs/sys/sys.h>
+#include <ucs/time/time.h>
+}
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <vector>
+
+
+UCS_FLAT_HASH_INIT(test_u64, uint64_t, uint64_t, ucs_flat_hash_int64_func,
+                   ucs_flat_hash_int64_equal);
+
+KHASH_INIT(test_kh_u64, uint64_t, uint64_t, 1, kh_int64_hash_func,
+           kh_int64_hash_equal);
+
+
+class test_flat_hash : public ucs::test {
+protected:
+    typedef ucs_flat_hash_t(test_u64) hash_t;
+    typedef std::map<uint64_t, uint64_t> map_t;
+
+    virtual void init() {
+        ucs::test::init();
+        ucs_flat_hash_init(test_u64, &m_hash);
+    }
+
+    virtual void cleanup() {
+        ucs_flat_hash_destroy(test_u64, &m_hash);
+        ucs::test::cleanup();
+    }
+
+    void put(uint64_t key, uint64_t value) {
+        ucs_flat_hash_iter_t iter;
+        int ret;
+
+        iter = ucs_flat_hash_put(test_u64, &m_hash, key, &ret);
+        ASSERT_GE(ret, 0);
+        ASSERT_NE(ucs_flat_hash_end(&m_hash), iter);
+        EXPECT_EQ(key, ucs_flat_hash_key(&m_hash, iter));
+        ucs_flat_hash_value(&m_hash, iter) = value;
+    }
+
+    void check(const map_t& map) {
+        ucs_flat_hash_iter_t iter;
+        uint64_t key, value;
+        size_t count;
+
+        ASSERT_EQ(map.size(), ucs_flat_hash_size(&m_hash));
+        for (map_t::const_iterator it = map.begin(); it != map.end(); ++it) {
+            iter = ucs_flat_hash_get(test_u64, &m_hash, it->first);
+            ASSERT_NE(ucs_flat_hash_end(&m_hash), iter) << "key " << it->first;
+            EXPECT_EQ(it->second, ucs_flat_hash_value(&m_hash, iter));
+        }
+
+        count = 0;
+        ucs_flat_hash_foreach(&m_hash, key, value, {
+            ASSERT_TRUE(map.find(key) != map.end()) << "key " << key;
+            EXPECT_EQ(map.find(key)->second, value);
+            ++count;
+        });
+        EXPECT_EQ(map.size(), count);
+    }
+
+    /* Key distributions seen by UCX hash tables */
+    enum key_dist {
+        KEYS_MSG_ID,  /* Fragment message id: sender uuid and sequence number */
+        KEYS_UUID,    /* Random worker uuid */
+        KEYS_SMALL,   /* File descriptor or timer id */
+        KEYS_SENDER,  /* Sender part of the tag, in the high bits */
+        KEYS_LAST
+    };
+
+    static std::vector<uint64_t> gen_keys(key_dist dist, size_t count) {
+        std::vector<uint64_t> keys;
+        uint64_t uuid = ucs_generate_uuid(0);
+
+        for (size_t i = 0; i < count; ++i) {
+            switch (dist) {
+            case KEYS_MSG_ID:
+                keys.push_back((uuid & ~UCS_MASK(32)) + i);
+                break;
+            case KEYS_UUID:
+                keys.push_back(ucs_generate_uuid(i));
+                break;
+            case KEYS_SENDER:
+                keys.push_back(i << 40);
+                break;
+            default:
+                keys.push_back(i);
+                break;
+            }
+        }
+
+        std::random_shuffle(keys.begin(), keys.end());
+        return keys;
+    }
+
+    hash_t m_hash;
+};
+
+
+UCS_TEST_F(test_flat_hash, empty) {
+    EXPECT_EQ(0ul, ucs_flat_hash_size(&m_hash));
+    EXPECT_EQ(ucs_flat_hash_end(&m_hash),
+              ucs_flat_hash_get(test_u64, &m_hash, 1));
+    check(map_t());
+}
+
+UCS_TEST_F(test_flat_hash, put_existing) {
+    ucs_flat_hash_iter_t iter;
+    int ret;
+
+    put(5, 50);
+
+    iter = ucs_flat_hash_put(test_u64, &m_hash, 5, &ret);
+    EXPECT_EQ(0, ret);
+    EXPECT_EQ(50ul, ucs_flat_hash_value(&m_hash, iter));
+    EXPECT_EQ(1ul, ucs_flat_hash_size(&m_hash));
+}
+
+UCS_TEST_F(test_flat_hash, random_ops) {
+    const unsigned count = 50000 / ucs::test_time_multiplier();
+    map_t map;
+    ucs_flat_hash_iter_t iter;
+    uint64_t key;
+
+    for (unsigned i = 0; i < count; ++i) {
+        /* small key range to have both hits and misses */
+        key = ucs::rand() % 4096;
+        if (ucs::rand() % 3) {
+            put(key, i);
+            map[key] = i;
+        } else {
+            iter = ucs_flat_hash_get(test_u64, &m_hash, key);
+            if (map.erase(key)) {
+                ASSERT_NE(ucs_flat_hash_end(&m_hash), iter);
+                ucs_flat_hash_del(test_u64, &m_hash, iter);
+            } else {
+                EXPECT_EQ(ucs_flat_hash_end(&m_hash), iter);
+            }
+        }
+    }
+
+    check(map);
+}
+
+UCS_TEST_F(test_flat_hash, del_in_foreach) {
+    map_t map;
+    ucs_flat_hash_iter_t iter;
+    uint64_t key;
+
+    for (key = 0; key < 1000; ++key) {
+        put(key, key * 2);
+    }
+
+    for (iter = 0; iter != ucs_flat_hash_end(&m_hash); ++iter) {
+        if (!ucs_flat_hash_exist(&m_hash, iter)) {
+            continue;
+        }
+
+        key = ucs_flat_hash_key(&m_hash, iter);
+        if (key % 2) {
+            ucs_flat_hash_del(test_u64, &m_hash, iter);
+        } else {
+            map[key] = key * 2;
+        }
+    }
+
+    check(map);
+}
+
+UCS_TEST_F(test_flat_hash, churn) {
+    size_t window       = 100;
+    size_t max_capacity = 0;
+
+    /* Sliding window of live keys, like fragment message ids - the deleted
+     * slots should be reclaimed without growing the table */
+    for (uint64_t key = 0; key < 100000; ++key) {
+        put(key, key);
+        if (key >= window) {
+            ucs_flat_hash_del(test_u64, &m_hash,
+                              ucs_flat_hash_get(test_u64, &m_hash,
+                                                key - window));
+        }
+        max_capacity = ucs_max(max_capacity, m_hash.capacity);
+    }
+
+    EXPECT_EQ(window, ucs_flat_hash_size(&m_hash));
+    EXPECT_LE(max_capacity, 4 * ucs_roundup_pow2(window));
+}
+
+UCS_TEST_F(test_flat_hash, perf) {
+    static const char *dist_names[] = {"msg_id", "uuid", "small",
+                                       "sender"};
+    static const size_t counts[]    = {1024, 100000};
+    const size_t lookups            = 2000000;
+    const int rounds                = 5;
+    khash_t(test_kh_u64) kh;
+    khiter_t kiter;
+    int ret;
+
+    if (ucs::test_time_multiplier() > 1) {
+        UCS_TEST_SKIP;
+    }
+
+    for (int dist = 0; dist < KEYS_LAST; ++dist) {
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+            size_t count               = counts[c];
+            size_t iters               = lookups / count;
+            std::vector<uint64_t> keys = gen_keys(key_dist(dist), count);
+            uint64_t sum_flat = 0, sum_kh = 0;
+            double kh_ns, flat_ns;
+
+            kh_init_inplace(test_kh_u64, &kh);
+            for (size_t i = 0; i < count; ++i) {
+                kiter = kh_put(test_kh_u64, &kh, keys[i], &ret);
+                kh_value(&kh, kiter) = i;
+                put(keys[i], i);
+            }
+
+            /* Take the best of several interleaved rounds to filter out
+             * noise, and retry if performance checks are enabled */
+            for (int retry = 0; retry <= ucs::perf_retry_count; ++retry) {
+                kh_ns = flat_ns = std::numeric_limits<double>::max();
+                for (int round = 0; round < rounds; ++round) {
+                    ucs_time_t start_time = ucs_get_time();
+                    for (size_t iter = 0; iter < iters; ++iter) {
+                        for (size_t i = 0; i < count; ++i) {
+                            kiter   = kh_get(test_kh_u64, &kh, keys[i]);
+                            sum_kh += kh_value(&kh, kiter);
+                        }
+                    }
+
+                    ucs_time_t mid_time = ucs_get_time();
+                    for (size_t iter = 0; iter < iters; ++iter) {
+                        for (size_t i = 0; i < count; ++i) {
+                            sum_flat += ucs_flat_hash_value(&m_hash,
+                                            ucs_flat_hash_get(test_u64, &m_hash,
+                                                              keys[i]));
+                        }
+                    }
+
+                    ucs_time_t end_time = ucs_get_time();
+                    kh_ns   = std::min(kh_ns,
+                                       ucs_time_to_nsec(mid_time - start_time) /
+                                       (count * iters));
+                    flat_ns = std::min(flat_ns,
+                                       ucs_time_to_nsec(end_time - mid_time) /
+                                       (count * iters));
+                }
+
+                if (flat_ns < kh_ns) {
+                    break;
+                }
+            }
+
+            EXPECT_EQ(sum_kh, sum_flat);
+            UCS_TEST_MESSAGE << dist_names[dist] << " x " << count
+                             << " lookup (nsec): khash " << kh_ns
+                             << " flat_hash " << flat_ns;
+
+            if (ucs::perf_retry_count) {
+                EXPECT_LT(flat_ns, kh_ns) << dist_names[dist] << " x " << count;
+            }
+
+            kh_destroy_inplace(test_kh_u64, &kh);
+            ucs_flat_hash_destroy(test_u64, &m_hash);
+            ucs_flat_hash_init(test_u64, &m_hash);
+        }
+    }
+}
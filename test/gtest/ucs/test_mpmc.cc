@@ -7,7 +7,9 @@
 #include <common/test.h>
 
 extern "C" {
+#include <ucs/arch/atomic.h>
 #include <ucs/datastruct/mpmc.h>
+#include <ucs/datastruct/mpmc_ring.h>
 }
 #include <pthread.h>
 
@@ -129,3 +131,190 @@ UCS_TEST_F(test_mpmc, multi_threaded) {
     EXPECT_TRUE(ucs_mpmc_queue_is_empty(&mpmc));
     ucs_mpmc_queue_cleanup(&mpmc);
 }
+
+
+class test_mpmc_ring : public ucs::test {
+protected:
+    static const unsigned RING_SIZE   = 64;
+    static const unsigned NUM_THREADS = 4;
+    static const unsigned BATCH       = 7;
+
+    struct elem {
+        uint32_t producer;
+        uint32_t seq;
+        uint64_t check;
+    };
+
+    struct thread_args {
+        ucs_mpmc_ring_t   *ring;
+        unsigned          index;
+        volatile uint64_t *remaining;
+    };
+
+    static long elem_count() {
+        return ucs_max((long)(100000.0 / (pow(ucs::test_time_multiplier(),
+                                              NUM_THREADS))), 500l);
+    }
+
+    static void *producer_thread_func(void *arg) {
+        thread_args *args = reinterpret_cast<thread_args*>(arg);
+        long count        = elem_count();
+        elem elems[BATCH];
+        unsigned n, pushed;
+        long seq;
+
+        seq = 0;
+        while (seq < count) {
+            n = ucs_min(BATCH, count - seq);
+            for (unsigned i = 0; i < n; ++i) {
+                elems[i].producer = args->index;
+                elems[i].seq      = seq + i;
+                elems[i].check    = ~(uint64_t)(seq + i);
+            }
+
+            /* Push either one by one or in batches */
+            if (seq % 2) {
+                for (unsigned i = 0; i < n; ++i) {
+                    while (ucs_mpmc_ring_push(args->ring, &elems[i]) != UCS_OK) {
+                        sched_yield();
+                    }
+                }
+            } else {
+                pushed = 0;
+                while (pushed < n) {
+                    pushed += ucs_mpmc_ring_push_n(args->ring, &elems[pushed],
+                                                   n - pushed);
+                    if (pushed < n) {
+                        sched_yield();
+                    }
+                }
+            }
+            seq += n;
+        }
+        return NULL;
+    }
+
+    static void *consumer_thread_func(void *arg) {
+        thread_args *args = reinterpret_cast<thread_args*>(arg);
+        long last_seq[NUM_THREADS];
+        elem elems[BATCH];
+        unsigned n;
+
+        for (unsigned i = 0; i < NUM_THREADS; ++i) {
+            last_seq[i] = -1;
+        }
+
+        while (*args->remaining > 0) {
+            n = ucs_mpmc_ring_pull_n(args->ring, elems, BATCH);
+            if (n == 0) {
+                sched_yield();
+            }
+            for (unsigned i = 0; i < n; ++i) {
+                EXPECT_LT(elems[i].producer, (unsigned)NUM_THREADS);
+                EXPECT_EQ(~(uint64_t)elems[i].seq, elems[i].check);
+                /* Elements from every producer must be pulled in order */
+                EXPECT_GT((long)elems[i].seq, last_seq[elems[i].producer]);
+                last_seq[elems[i].producer] = elems[i].seq;
+            }
+            ucs_atomic_add64(args->remaining, -(int64_t)n);
+        }
+        return NULL;
+    }
+};
+
+UCS_TEST_F(test_mpmc_ring, basic) {
+    ucs_mpmc_ring_t ring;
+    ucs_status_t status;
+    void *ptr;
+
+    status = ucs_mpmc_ring_init(&ring, 4, sizeof(void*));
+    ASSERT_UCS_OK(status);
+
+    EXPECT_TRUE(ucs_mpmc_ring_is_empty(&ring));
+    status = ucs_mpmc_ring_pull_ptr(&ring, &ptr);
+    EXPECT_EQ(UCS_ERR_NO_PROGRESS, status);
+
+    for (uintptr_t i = 0; i < 4; ++i) {
+        status = ucs_mpmc_ring_push_ptr(&ring, (void*)(0x1000 + i));
+        ASSERT_UCS_OK(status);
+    }
+
+    status = ucs_mpmc_ring_push_ptr(&ring, NULL);
+    EXPECT_EQ(UCS_ERR_EXCEEDS_LIMIT, status);
+    EXPECT_FALSE(ucs_mpmc_ring_is_empty(&ring));
+
+    for (uintptr_t i = 0; i < 4; ++i) {
+        status = ucs_mpmc_ring_pull_ptr(&ring, &ptr);
+        ASSERT_UCS_OK(status);
+        EXPECT_EQ((void*)(0x1000 + i), ptr);
+    }
+
+    EXPECT_TRUE(ucs_mpmc_ring_is_empty(&ring));
+    ucs_mpmc_ring_cleanup(&ring);
+}
+
+UCS_TEST_F(test_mpmc_ring, batch) {
+    static const unsigned SIZE = 8;
+    ucs_mpmc_ring_t ring;
+    ucs_status_t status;
+    uint64_t in[SIZE * 2], out[SIZE * 2];
+    unsigned n;
+
+    status = ucs_mpmc_ring_init(&ring, SIZE, sizeof(uint64_t));
+    ASSERT_UCS_OK(status);
+
+    for (unsigned lap = 0; lap < 3; ++lap) {
+        for (unsigned i = 0; i < SIZE * 2; ++i) {
+            in[i] = (lap << 16) | i;
+        }
+
+        /* Only SIZE elements fit */
+        n = ucs_mpmc_ring_push_n(&ring, in, SIZE * 2);
+        EXPECT_EQ(SIZE, n);
+        EXPECT_EQ(0u, ucs_mpmc_ring_push_n(&ring, in, 1));
+
+        n = ucs_mpmc_ring_pull_n(&ring, out, 3);
+        EXPECT_EQ(3u, n);
+        n = ucs_mpmc_ring_pull_n(&ring, out + 3, SIZE * 2);
+        EXPECT_EQ(SIZE - 3, n);
+        EXPECT_EQ(0u, ucs_mpmc_ring_pull_n(&ring, out, SIZE));
+
+        for (unsigned i = 0; i < SIZE; ++i) {
+            EXPECT_EQ(in[i], out[i]);
+        }
+    }
+
+    ucs_mpmc_ring_cleanup(&ring);
+}
+
+UCS_TEST_F(test_mpmc_ring, multi_threaded) {
+    pthread_t producers[NUM_THREADS];
+    pthread_t consumers[NUM_THREADS];
+    thread_args prod_args[NUM_THREADS];
+    thread_args cons_args[NUM_THREADS];
+    volatile uint64_t remaining;
+    ucs_mpmc_ring_t ring;
+    ucs_status_t status;
+
+    status = ucs_mpmc_ring_init(&ring, RING_SIZE, sizeof(elem));
+    ASSERT_UCS_OK(status);
+
+    remaining = NUM_THREADS * elem_count();
+    for (unsigned i = 0; i < NUM_THREADS; ++i) {
+        prod_args[i].ring      = &ring;
+        prod_args[i].index     = i;
+        prod_args[i].remaining = &remaining;
+        cons_args[i]           = prod_args[i];
+        pthread_create(&producers[i], NULL, producer_thread_func, &prod_args[i]);
+        pthread_create(&consumers[i], NULL, consumer_thread_func, &cons_args[i]);
+    }
+
+    for (unsigned i = 0; i < NUM_THREADS; ++i) {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+    }
+
+    EXPECT_EQ(0ul, remaining);
+    EXPECT_TRUE(ucs_mpmc_ring_is_empty(&ring));
+    ucs_mpmc_ring_cleanup(&ring);
+}